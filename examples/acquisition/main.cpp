@@ -0,0 +1,50 @@
+#include <Arduino.h>
+#include "cm1106_uart.h"
+#include "cm1106_acquisition.h"
+
+
+// Modify if CM1106 is attached to other hardware port
+#define CM1106_serial Serial2
+
+#define CONSOLE_BAUDRATE 115200
+#define SAMPLE_PERIOD   5000                                   // Time between CO2 readings (ms)
+
+
+CM1106_UART *sensor_CM1106;
+CM1106_Acquisition *acquisition;
+
+
+void setup() {
+
+    // Initialize console serial communication
+    Serial.begin(CONSOLE_BAUDRATE);
+    Serial.println("");
+
+    Serial.println("Init");
+
+    // Initialize sensor
+    CM1106_serial.begin(CM1106_BAUDRATE);
+    sensor_CM1106 = new CM1106_UART(CM1106_serial);
+
+    // Sample the sensor in a task on core 0
+    acquisition = new CM1106_Acquisition(*sensor_CM1106, SAMPLE_PERIOD);
+    acquisition->start();
+
+    Serial.println("Setup done!");
+}
+
+
+void loop() {
+    CM1106_reading reading;
+
+    // Readings are taken without waiting the sensor
+    while (acquisition->pop(&reading)) {
+        if (reading.status == CM1106_READING_OK) {
+            Serial.printf("[%u ms] CO2 value: %d ppm\n", reading.timestamp, reading.co2);
+        } else {
+            Serial.printf("[%u ms] Error getting CO2 value!\n", reading.timestamp);
+        }
+    }
+
+    delay(1000);
+}
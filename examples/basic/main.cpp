@@ -1,5 +1,6 @@
 #include <Arduino.h>
 #include "cm1106_uart.h"
+#include "cm1106_config.h"
 
 
 #ifdef USE_SOFTWARE_SERIAL
@@ -22,6 +23,7 @@
 CM1106_UART *sensor_CM1106;
 CM1106_sensor sensor;
 CM1106_ABC abc;
+CM1106_Config config;
 
 
 void setup() {
@@ -35,32 +37,37 @@ void setup() {
     // Initialize sensor
     CM1106_serial.begin(CM1106_BAUDRATE);
     sensor_CM1106 = new CM1106_UART(CM1106_serial);
-
-    // Check if CM1106 is available
-    sensor_CM1106->get_software_version(sensor.softver);
-    int len = strlen(sensor.softver);
-    if (len > 0) {
-        if (len >= 10 && !strncmp(sensor.softver+len-5, "SL-NS", 5)) {
-            Serial.println("CM1106SL-NS detected");
-        } else if (!strncmp(sensor.softver, "CM", 2)) {
+    sensor_CM1106->enable_cache(true);      // Settings read at boot are not requested again
+
+    // Detect CM1106 and its model, read software version and serial number
+    switch (sensor_CM1106->probe(&sensor)) {
+        case CM1106_MODEL_SL_N:
+            Serial.println("CM1106SL-N(S) detected");
+            break;
+        case CM1106_MODEL_CM1106:
             Serial.println("CM1106 detected");
-        } else {
+            break;
+        case CM1106_MODEL_UNKNOWN:
             Serial.println("CM1106 unknown version");
-        }
-    } else {
-        Serial.println("CM1106 not found!");
-        while (1) { delay(1); };
-    }     
+            break;
+        default:
+            Serial.println("CM1106 not found!");
+            while (1) { delay(1); };
+    }
 
     // Show sensor info
     Serial.println(">>> Cubic CM1106 NDIR CO2 sensor <<<");  
-    sensor_CM1106->get_serial_number(sensor.sn);
     Serial.printf("Serial number: %s\n", sensor.sn);
     Serial.printf("Software version: %s\n", sensor.softver);
 
-    // Setup ABC parameters
+    // Setup ABC parameters, written only if the sensor has other ones
     Serial.println("Setting ABC parameters...");
-    sensor_CM1106->set_ABC(CM1106_ABC_OPEN, 7, 415);    // 7 days cycle, 415 ppm for base
+    config.set_ABC(CM1106_ABC_OPEN, 7, 415);    // 7 days cycle, 415 ppm for base
+    if (!config.apply(*sensor_CM1106)) {
+        Serial.println("Error setting ABC parameters!");
+    } else if (config.get_written() == 0) {
+        Serial.println("ABC parameters already set");
+    }
 
     // Getting ABC parameters
     if (sensor_CM1106->get_ABC(&abc)) {
@@ -0,0 +1,226 @@
+/*
+    Latency and throughput benchmark of CM1106 Library against the emulated sensor
+
+    For each command: p50/p99 latency split in encode/write, wait and receive/parse,
+    CPU time while waiting the response, readings per second and cost of each failure mode.
+*/
+
+#include <Arduino.h>
+#include <time.h>
+#include <algorithm>
+#include <vector>
+#include "cm1106_uart.h"
+#include "cm1106_emulator.h"
+
+#define ITERATIONS    200                  // Transactions per command
+#define FAILURES       10                  // Transactions per failure mode
+
+
+/* Monotonic time with nanosecond resolution (us) */
+static double now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+
+/* Stream between the library and the emulator which timestamps the phases of each transaction */
+class SpyStream : public Stream
+{
+    public:
+        SpyStream(Stream &target) : target(target) {}
+
+        int available() override {
+            int nb = target.available();
+            if (nb == 0) {
+                empty_polls++;
+            }
+            return nb;
+        }
+        int read() override {
+            int c = target.read();
+            if (c >= 0) {
+                if (first_rx_us == 0) {
+                    first_rx_us = now_us();
+                }
+                last_rx_us = now_us();
+            }
+            return c;
+        }
+        int peek() override { return target.peek(); }
+        size_t write(uint8_t data) override {
+            if (tx_us == 0) {
+                tx_us = now_us();
+            }
+            return target.write(data);
+        }
+        using Print::write;
+        void flush() override { target.flush(); }
+
+        void reset() { tx_us = first_rx_us = last_rx_us = 0; empty_polls = 0; }
+
+        Stream &target;
+        double tx_us = 0;
+        double first_rx_us = 0;
+        double last_rx_us = 0;
+        unsigned long empty_polls = 0;
+};
+
+
+struct Sample {
+    double total_us;
+    double encode_us;
+    double wait_us;
+    double parse_us;
+    double cpu_us;
+    unsigned long empty_polls;
+};
+
+
+static double cpu_time_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+
+static double percentile(std::vector<double> values, double p) {
+    std::sort(values.begin(), values.end());
+    size_t i = (size_t)(p * (values.size() - 1) + 0.5);
+    return values[i];
+}
+
+
+/* Run a command several times and show its statistics */
+template <typename F>
+void bench(const char *name, SpyStream &spy, F command) {
+    std::vector<Sample> samples;
+
+    for (int i = 0; i < ITERATIONS; i++) {
+        spy.reset();
+        double cpu_start = cpu_time_us();
+        double start_us = now_us();
+        command();
+        double end_us = now_us();
+        double cpu_end = cpu_time_us();
+
+        Sample s;
+        s.total_us = end_us - start_us;
+        s.encode_us = spy.tx_us ? spy.tx_us - start_us : 0;
+        s.wait_us = spy.first_rx_us ? spy.first_rx_us - spy.tx_us : 0;
+        s.parse_us = spy.last_rx_us ? end_us - spy.first_rx_us : 0;
+        s.cpu_us = cpu_end - cpu_start;
+        s.empty_polls = spy.empty_polls;
+        samples.push_back(s);
+    }
+
+    std::vector<double> total, encode, wait, parse, cpu;
+    double polls = 0;
+    for (const Sample &s : samples) {
+        total.push_back(s.total_us);
+        encode.push_back(s.encode_us);
+        wait.push_back(s.wait_us);
+        parse.push_back(s.parse_us);
+        cpu.push_back(s.cpu_us);
+        polls += s.empty_polls;
+    }
+
+    double p50 = percentile(total, 0.50);
+    Serial.printf("%-24s p50 %9.2f  p99 %9.2f  encode %6.2f  wait %9.2f  rx+parse %9.2f  cpu %9.2f  polls %7.0f  %9.1f/s\n",
+                  name, p50, percentile(total, 0.99), percentile(encode, 0.50), percentile(wait, 0.50),
+                  percentile(parse, 0.50), percentile(cpu, 0.50), polls / ITERATIONS, 1e6 / p50);
+}
+
+
+/* Measure cost of a failed CO2 reading */
+void bench_failure(const char *name, void (*fault)(CM1106_Emulator &emulator)) {
+    CM1106_Emulator emulator;
+    CM1106_UART sensor_CM1106(emulator);
+    double worst = 0, sum = 0;
+
+    // Round trip time is learnt while the sensor is healthy
+    for (int i = 0; i < FAILURES; i++) {
+        sensor_CM1106.get_co2();
+    }
+    fault(emulator);
+
+    for (int i = 0; i < FAILURES; i++) {
+        double start_us = now_us();
+        sensor_CM1106.get_co2();
+        double t = now_us() - start_us;
+        sum += t;
+        worst = std::max(worst, t);
+    }
+    Serial.printf("%-24s mean %9.1f  max %9.1f\n", name, sum / FAILURES, worst);
+}
+
+
+/* Run all commands against an emulator */
+void bench_commands(CM1106_Emulator &emulator) {
+    SpyStream spy(emulator);
+    CM1106_UART sensor_CM1106(spy);
+    CM1106_sensor sensor;
+    CM1106_ABC abc;
+    int16_t period;
+    uint8_t smoothed, mode;
+
+    bench("get_co2", spy, [&]() { sensor_CM1106.get_co2(); });
+    bench("get_serial_number", spy, [&]() { sensor_CM1106.get_serial_number(sensor.sn); });
+    bench("get_software_version", spy, [&]() { sensor_CM1106.get_software_version(sensor.softver); });
+    bench("get_ABC", spy, [&]() { sensor_CM1106.get_ABC(&abc); });
+    bench("set_ABC", spy, [&]() { sensor_CM1106.set_ABC(CM1106_ABC_OPEN, 7, 415); });
+    bench("start_calibration", spy, [&]() { sensor_CM1106.start_calibration(400); });
+    bench("get_measurement_period", spy, [&]() { sensor_CM1106.get_measurement_period(&period, &smoothed); });
+    bench("set_measurement_period", spy, [&]() { sensor_CM1106.set_measurement_period(60, 1); });
+    bench("get_working_status", spy, [&]() { sensor_CM1106.get_working_status(&mode); });
+    bench("set_working_status", spy, [&]() { sensor_CM1106.set_working_status(CM1106_CONTINUOUS_MEASUREMENT); });
+    bench("store_ABC_data", spy, [&]() { sensor_CM1106.store_ABC_data(); });
+}
+
+
+/* Compare driver for generic Stream and driver templated on the emulator type */
+template <class Driver>
+void bench_driver(const char *name) {
+    CM1106_Emulator emulator;
+    emulator.set_latency(0);
+    emulator.set_byte_time(0);
+    Driver sensor_CM1106(emulator);
+    std::vector<double> total;
+
+    for (int i = 0; i < ITERATIONS * 10; i++) {
+        double start_us = now_us();
+        sensor_CM1106.get_co2();
+        total.push_back(now_us() - start_us);
+    }
+
+    Serial.printf("%-36s get_co2 p50 %6.3f us  p99 %6.3f us  sizeof %u bytes\n", name,
+                  percentile(total, 0.50), percentile(total, 0.99), (unsigned)sizeof(Driver));
+}
+
+
+int main() {
+
+    Serial.println("Latency in us (p50 unless noted)");
+
+    Serial.println("\n>>> 9600 baud, 2 ms response latency <<<");
+    CM1106_Emulator uart(CM1106_EMU_MODEL_SL_NS);
+    bench_commands(uart);
+
+    Serial.println("\n>>> Instantaneous link (library overhead) <<<");
+    CM1106_Emulator fast(CM1106_EMU_MODEL_SL_NS);
+    fast.set_latency(0);
+    fast.set_byte_time(0);
+    bench_commands(fast);
+
+    Serial.println("\n>>> Serial dispatch (instantaneous link) <<<");
+    bench_driver<CM1106_UART>("CM1106_UART (Stream)");
+    bench_driver<CM1106_UART_T<CM1106_Emulator> >("CM1106_UART_T<CM1106_Emulator>");
+
+    Serial.println("\n>>> Cost of failed get_co2 <<<");
+    bench_failure("no reply", [](CM1106_Emulator &emulator) { emulator.set_silent(true); });
+    bench_failure("short reply", [](CM1106_Emulator &emulator) { emulator.set_truncate_rate(100); });
+    bench_failure("bad checksum", [](CM1106_Emulator &emulator) { emulator.set_corrupt_rate(100); });
+    bench_failure("NAK", [](CM1106_Emulator &emulator) { emulator.set_nak_rate(100); });
+
+    return 0;
+}
@@ -0,0 +1,177 @@
+/*
+    Encode readings of CM1106 Library into compact blocks for uplink and decode them
+
+    A week of readings every 10 s (slow CO2 changes with noise, timestamps delayed up to 10 ms,
+    a few errors) is encoded into fixed-size blocks, compared with JSON, and decoded back
+    reading by reading and in bulk.
+*/
+
+#include <Arduino.h>
+#include <chrono>
+#include <vector>
+#include "cm1106_uart.h"
+#include "cm1106_codec.h"
+#include "cm1106_bulk_decoder.h"
+
+#define PERIOD             10000     // Period of readings (ms)
+#define JITTER                10     // Max delay of readings (ms), e.g. wake up of a task
+#define READINGS           60480     // A week of readings
+#define DECODE_ROUNDS        100     // Rounds of decoding to measure speed
+
+
+/* Real time (ms) */
+static double real_ms() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+/* Readings of a room: occupied during working hours, scheduler jitter up to JITTER ms */
+std::vector<CM1106_reading> make_readings() {
+    std::vector<CM1106_reading> readings;
+    uint32_t seed = 1106;
+    double co2 = 420;
+
+    for (uint32_t i = 0; i < READINGS; i++) {
+        seed = seed * 1103515245 + 12345;
+        uint32_t hour = (i * PERIOD / 3600000) % 24;
+        double target = (hour >= 9 && hour < 18) ? 1100 : 420;
+        co2 += (target - co2) / 200;
+
+        CM1106_reading reading;
+        reading.timestamp = 1000 + i * PERIOD + (seed >> 16) % (JITTER + 1);
+        reading.co2 = (int16_t)co2 + (int16_t)((seed >> 8) % 7) - 3;
+        reading.status = CM1106_READING_OK;
+        if ((seed >> 4) % 1000 == 0) {
+            reading.co2 = 0;
+            reading.status = CM1106_READING_ERROR;
+        }
+        readings.push_back(reading);
+    }
+    return readings;
+}
+
+
+/* Size of readings as JSON built by hand */
+size_t json_size(const std::vector<CM1106_reading> &readings) {
+    char json[64];
+    size_t size = 0;
+
+    for (const CM1106_reading &reading : readings) {
+        size += snprintf(json, sizeof(json), "{\"t\":%u,\"co2\":%d,\"s\":%u}", reading.timestamp, reading.co2, reading.status);
+    }
+    return size;
+}
+
+
+/* Encode readings into blocks */
+std::vector<uint8_t> encode(const std::vector<CM1106_reading> &readings, uint8_t size) {
+    std::vector<uint8_t> stream;
+    uint8_t block[255];
+    CM1106_Encoder encoder(block, size);
+
+    for (const CM1106_reading &reading : readings) {
+        if (!encoder.add(reading)) {
+            stream.insert(stream.end(), block, block + encoder.finish());
+            encoder.reset();
+            encoder.add(reading);
+        }
+    }
+    stream.insert(stream.end(), block, block + encoder.finish());
+    return stream;
+}
+
+
+/* Failed checks, exit status of the program */
+static int failures = 0;
+
+void check(bool ok, const char *what) {
+    if (!ok) {
+        printf("FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+
+/* Check that decoded readings are the original ones */
+bool same(const std::vector<CM1106_reading> &readings, const uint32_t *timestamp, const int16_t *co2, const uint8_t *status, size_t count) {
+    if (count != readings.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (readings[i].timestamp != timestamp[i] || readings[i].co2 != co2[i] || readings[i].status != status[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+int main() {
+    std::vector<CM1106_reading> readings = make_readings();
+    std::vector<uint32_t> timestamp(READINGS);
+    std::vector<int16_t> co2(READINGS);
+    std::vector<uint8_t> status(READINGS);
+    size_t json = json_size(readings);
+
+    printf("%u readings, JSON: %zu bytes (%.1f bytes per reading)\n\n", READINGS, json, (double)json / READINGS);
+
+    const uint8_t sizes[] = {64, CM1106_CODEC_BLOCK, 255};
+    for (uint8_t size : sizes) {
+        std::vector<uint8_t> stream = encode(readings, size);
+        printf("Blocks of %3u bytes: %5zu blocks, %6zu bytes, %.2f bytes per reading\n",
+               size, stream.size() / size, stream.size(), (double)stream.size() / READINGS);
+
+        // Reading by reading
+        size_t count = 0;
+        double start = real_ms();
+        for (int round = 0; round < DECODE_ROUNDS; round++) {
+            count = 0;
+            for (size_t offset = 0; offset < stream.size(); offset += size) {
+                CM1106_Decoder decoder(&stream[offset], size);
+                CM1106_reading reading;
+                while (count < READINGS && decoder.next(&reading)) {
+                    timestamp[count] = reading.timestamp;
+                    co2[count] = reading.co2;
+                    status[count++] = reading.status;
+                }
+            }
+        }
+        double elapsed = real_ms() - start;
+        bool ok = same(readings, timestamp.data(), co2.data(), status.data(), count);
+        printf("    Decoder:      %s, %.0f readings/ms\n", ok ? "same readings" : "DIFFERENT readings",
+               (double)READINGS * DECODE_ROUNDS / elapsed);
+        check(ok, "readings of decoder");
+
+        // In bulk
+        CM1106_BulkDecoder bulk(size);
+        start = real_ms();
+        for (int round = 0; round < DECODE_ROUNDS; round++) {
+            count = bulk.decode(stream.data(), stream.size(), timestamp.data(), co2.data(), status.data(), READINGS);
+        }
+        elapsed = real_ms() - start;
+        ok = same(readings, timestamp.data(), co2.data(), status.data(), count);
+        printf("    Bulk decoder: %s, %.0f readings/ms\n", ok ? "same readings" : "DIFFERENT readings",
+               (double)READINGS * DECODE_ROUNDS / elapsed);
+        check(ok, "readings of bulk decoder");
+
+        // A corrupted block is skipped
+        stream[size + CM1106_CODEC_HEADER] ^= 0x10;
+        count = bulk.decode(stream.data(), stream.size(), timestamp.data(), co2.data(), status.data(), READINGS);
+        printf("    Corrupted:    %zu invalid block, %zu readings decoded\n\n", bulk.get_invalid(), count);
+        check(bulk.get_invalid() == 1 && count < READINGS, "corrupted block skipped");
+    }
+
+    // Blocks too short for a header and a checksum are rejected without reading them
+    uint8_t empty[1] = {CM1106_CODEC_VERSION};
+    CM1106_Decoder short_decoder(empty, 1);
+    CM1106_BulkDecoder short_bulk(0);
+    size_t short_count = short_bulk.decode(empty, sizeof(empty), timestamp.data(), co2.data(), status.data(), READINGS);
+    printf("Short blocks: decoder valid %d, bulk decoder %zu readings\n", short_decoder.is_valid(), short_count);
+    check(!short_decoder.is_valid() && short_count == 0, "short blocks rejected");
+
+    if (failures > 0) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,83 @@
+/*
+    Read thousands of CM1106 sensors with C++20 coroutines from one thread (Linux).
+    Each sensor conversation is straight-line code, resumed by CM1106_Reactor when
+    bytes arrive or the response deadline expires. Sensors are emulated behind
+    pseudo terminal pairs.
+*/
+
+#include <Arduino.h>
+#include "cm1106_coro.h"
+#include "cm1106_pty_bridge.h"
+
+#define NUM_SENSORS    1000
+#define NUM_READINGS     10
+#define PERIOD_MS        50
+
+
+struct Totals {
+    uint32_t readings = 0;
+    uint32_t errors = 0;
+    uint32_t done = 0;
+};
+
+
+/* Conversation with one sensor */
+CM1106_Task read_sensor(CM1106_Reactor &reactor, CM1106_AsyncUART &sensor, int index, Totals &totals) {
+
+    std::optional<CM1106_ABC> abc = co_await sensor.abc();
+    if (index == 0 && abc) {
+        Serial.printf("Sensor 0 ABC: open/close %d, cycle %d, base %d\n", abc->open_close, abc->cycle, abc->base);
+    }
+
+    for (int i = 0; i < NUM_READINGS; i++) {
+        std::optional<int16_t> co2 = co_await sensor.co2();
+        if (co2) {
+            totals.readings++;
+        } else {
+            totals.errors++;
+        }
+        if (index == 0 && co2) {
+            Serial.printf("Sensor 0 CO2: %d ppm\n", *co2);
+        }
+        co_await reactor.sleep(PERIOD_MS);
+    }
+
+    totals.done++;
+}
+
+
+int main(int argc, char *argv[]) {
+    int num_sensors = argc > 1 ? atoi(argv[1]) : NUM_SENSORS;
+    CM1106_PtyBridge bridge;
+    CM1106_Reactor reactor;
+    std::vector<std::unique_ptr<CM1106_PosixSerial>> ports;
+    std::vector<std::unique_ptr<CM1106_AsyncUART>> sensors;
+    Totals totals;
+
+    for (int i = 0; i < num_sensors; i++) {
+        int slave = bridge.add();
+        if (slave < 0) {
+            Serial.printf("Only %d pseudo terminals available\n", i);
+            break;
+        }
+        bridge.get_emulator(i)->set_co2(400 + i % 1000);
+        ports.emplace_back(new CM1106_PosixSerial());
+        ports.back()->begin(slave, true);
+        sensors.emplace_back(new CM1106_AsyncUART(reactor, *ports.back()));
+    }
+    bridge.start();
+
+    unsigned long start = millis();
+    for (size_t i = 0; i < sensors.size(); i++) {
+        read_sensor(reactor, *sensors[i], i, totals);
+    }
+    reactor.run();
+    unsigned long elapsed = millis() - start;
+
+    bridge.stop();
+
+    Serial.printf("Sensors: %u, completed: %u\n", (unsigned)sensors.size(), (unsigned)totals.done);
+    Serial.printf("Readings: %u valid, %u errors in %lu ms\n", (unsigned)totals.readings, (unsigned)totals.errors, elapsed);
+
+    return 0;
+}
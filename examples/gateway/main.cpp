@@ -0,0 +1,65 @@
+/*
+    Read hundreds of CM1106 sensors on POSIX serial ports from one thread (Linux gateway).
+    Sensors are emulated behind pseudo terminal pairs: the library opens the slave side,
+    a bridge thread connects each master side to a CM1106_Emulator.
+*/
+
+#include <Arduino.h>
+#include "cm1106_epoll.h"
+#include "cm1106_pty_bridge.h"
+#include <time.h>
+
+#define NUM_SENSORS    500
+#define DURATION_MS   5000
+
+
+/* CPU time of calling thread (us) */
+static uint64_t thread_cpu_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+int main(int argc, char *argv[]) {
+    int num_sensors = argc > 1 ? atoi(argv[1]) : NUM_SENSORS;
+    CM1106_Epoll gateway;
+    CM1106_PtyBridge bridge;
+
+    for (int i = 0; i < num_sensors; i++) {
+        int slave = bridge.add();
+        if (slave < 0) {
+            Serial.printf("Only %d pseudo terminals available\n", i);
+            break;
+        }
+        bridge.get_emulator(i)->set_co2(400 + i);
+        if (gateway.add(slave, true) < 0) {
+            Serial.printf("Error adding sensor %d\n", i);
+            return 1;
+        }
+    }
+    Serial.printf("Sensors: %u\n", (unsigned)gateway.get_count());
+
+    bridge.start();
+
+    std::vector<CM1106_reading> readings(gateway.get_count());
+    uint32_t sweeps = 0, valid = 0;
+    uint64_t cpu_start = thread_cpu_us();
+    unsigned long start = millis();
+
+    while (millis() - start < DURATION_MS) {
+        valid += gateway.sweep(readings.data());
+        sweeps++;
+    }
+
+    unsigned long elapsed = millis() - start;
+    uint64_t cpu = thread_cpu_us() - cpu_start;
+    bridge.stop();
+
+    Serial.printf("Sweeps: %u in %lu ms (%.1f ms each)\n", (unsigned)sweeps, elapsed, (double)elapsed / sweeps);
+    Serial.printf("Valid readings: %u of %u (%.0f readings/s)\n", (unsigned)valid, (unsigned)(sweeps * gateway.get_count()), valid * 1000.0 / elapsed);
+    Serial.printf("Gateway thread CPU: %.1f%% (%.1f us per reading)\n", cpu * 100.0 / (elapsed * 1000.0), valid > 0 ? (double)cpu / valid : 0.0);
+    Serial.printf("Last reading of sensor 0: %d ppm\n", readings[0].co2);
+
+    return 0;
+}
@@ -0,0 +1,70 @@
+#include <Arduino.h>
+#include "cm1106_uart.h"
+#include "cm1106_lowpower.h"
+
+
+// Modify if CM1106 is attached to other hardware port
+#define CM1106_serial Serial2
+
+#define CM1106_EN_PIN        4                                 // GPIO driving power switch (or enable) of the sensor
+#define CONSOLE_BAUDRATE 115200
+#define SAMPLE_PERIOD    60000                                 // Time between CO2 readings (ms)
+#define MIN_SLEEP           10                                 // Shorter waits are done awake (ms), UART does not receive in light sleep
+
+
+CM1106_UART *sensor_CM1106;
+CM1106_LowPower *lowpower;
+
+
+/* Power on/off the sensor */
+void sensor_enable(bool enable) {
+    digitalWrite(CM1106_EN_PIN, enable ? HIGH : LOW);
+}
+
+
+void setup() {
+
+    // Initialize console serial communication
+    Serial.begin(CONSOLE_BAUDRATE);
+    Serial.println("");
+
+    Serial.println("Init");
+
+    pinMode(CM1106_EN_PIN, OUTPUT);
+
+    // Initialize sensor
+    CM1106_serial.begin(CM1106_BAUDRATE);
+    sensor_CM1106 = new CM1106_UART(CM1106_serial);
+
+    // Sensor in single measurement mode, powered only while measuring
+    lowpower = new CM1106_LowPower(*sensor_CM1106, SAMPLE_PERIOD);
+    lowpower->set_trigger(sensor_enable);
+    if (!lowpower->begin()) {
+        Serial.println("Single measurement mode not supported!");
+    }
+
+    Serial.println("Setup done!");
+}
+
+
+void loop() {
+    CM1106_reading reading;
+
+    if (lowpower->run() && lowpower->get_reading(&reading)) {
+        if (reading.status == CM1106_READING_OK) {
+            Serial.printf("[%u ms] CO2 value: %d ppm\n", reading.timestamp, reading.co2);
+        } else {
+            Serial.printf("[%u ms] Error getting CO2 value!\n", reading.timestamp);
+        }
+        Serial.flush();
+    }
+
+    // Sleep until next step of the duty cycle
+    uint32_t sleep_ms = lowpower->get_sleep_time();
+    if (sleep_ms >= MIN_SLEEP) {
+        esp_sleep_enable_timer_wakeup(sleep_ms * 1000ULL);
+        esp_light_sleep_start();
+    } else if (sleep_ms > 0) {
+        delay(sleep_ms);
+    }
+}
@@ -0,0 +1,192 @@
+/*
+    Awake time and energy per reading of duty-cycled acquisition against the emulated CM1106SL-NS
+
+    The emulator runs on virtual time: sleeps of the host move the clock forward at once,
+    so hours of operation take a fraction of a second. Currents are example figures.
+*/
+
+#include <Arduino.h>
+#include "cm1106_uart.h"
+#include "cm1106_lowpower.h"
+#include "cm1106_emulator.h"
+#include "cm1106_virtual_clock.h"
+
+#define SIM_HOURS            24                  // Emulated time of each scenario
+#define SAMPLE_PERIOD     60000                  // Time between CO2 readings (ms)
+#define MEASURE_TIME       2000                  // Time from enable to measurement of the sensor (ms)
+
+#define SUPPLY_V            3.3                  // Supply voltage (V)
+#define MCU_ACTIVE_MA      40.0                  // Host awake (mA)
+#define MCU_SLEEP_MA        0.8                  // Host in light sleep (mA)
+#define MCU_WAKE_US         500                  // Host wake up from sleep (us)
+#define SENSOR_ON_MA       15.0                  // Sensor powered, average (mA)
+
+
+CM1106_VirtualClock virtual_clock;
+CM1106_Emulator emulator(CM1106_EMU_MODEL_SL_NS);
+CM1106_UART sensor(emulator);
+
+static uint64_t sensor_on_us;                    // Time sensor was powered
+static unsigned long sensor_on_start;
+
+
+/* Power on/off the emulated sensor */
+void sensor_enable(bool enable) {
+    if (enable) {
+        sensor_on_start = cm1106_micros();
+    } else {
+        sensor_on_us += cm1106_micros() - sensor_on_start;
+    }
+    emulator.set_enabled(enable);
+}
+
+
+struct Result {
+    uint32_t readings;
+    uint32_t errors;
+    uint32_t stale;                              // Readings not matching value of the sensor
+    uint64_t elapsed_us;
+    uint64_t sleep_us;
+    uint32_t wakes;
+    uint64_t sensor_us;
+};
+
+
+/* Print awake time and energy per reading */
+void print_result(const char *name, const Result &r) {
+    double awake_us = (double)(r.elapsed_us - r.sleep_us) + (double)r.wakes * MCU_WAKE_US;
+    double mcu_mj = SUPPLY_V * (MCU_ACTIVE_MA * awake_us + MCU_SLEEP_MA * (r.elapsed_us - awake_us)) / 1e6;
+    double sensor_mj = SUPPLY_V * SENSOR_ON_MA * r.sensor_us / 1e6;
+    double n = r.readings > 0 ? r.readings : 1;
+
+    printf("%-22s %8u %6u %6u %12.2f %8.3f %10.2f %10.2f %10.2f\n", name, r.readings, r.errors, r.stale,
+           awake_us / n / 1000, 100.0 * awake_us / r.elapsed_us, mcu_mj / n, sensor_mj / n, (mcu_mj + sensor_mj) / n);
+}
+
+
+/* Check a reading against the value set in the emulator */
+void count_reading(Result &r, bool ok, int16_t co2, int16_t expected) {
+    r.readings++;
+    if (!ok) {
+        r.errors++;
+    } else if (co2 != expected) {
+        r.stale++;
+    }
+}
+
+
+/* Host awake, sensor in continuous mode, delay() between readings */
+Result run_polling() {
+    Result r = {};
+    unsigned long start = cm1106_micros();
+    int16_t co2 = 600;
+
+    sensor.set_working_status(CM1106_CONTINUOUS_MEASUREMENT);
+    emulator.set_enabled(true);
+
+    unsigned long next = cm1106_millis();
+    while (cm1106_micros() - start < SIM_HOURS * 3600000000UL) {
+        emulator.set_co2(++co2);
+        int16_t value;
+        bool ok = sensor.get_co2(&value);
+        count_reading(r, ok, value, co2);
+        next += SAMPLE_PERIOD;
+        long wait_ms = (long)(next - cm1106_millis());
+        if (wait_ms > 0) {
+            cm1106_delay(wait_ms);
+        }
+    }
+
+    r.elapsed_us = cm1106_micros() - start;
+    r.sensor_us = r.elapsed_us;
+    return r;
+}
+
+
+/* Host sleeps between blocking readings, sensor in continuous mode */
+Result run_blocking_sleep() {
+    Result r = {};
+    unsigned long start = cm1106_micros();
+    int16_t co2 = 600;
+
+    unsigned long next = cm1106_millis();
+    while (cm1106_micros() - start < SIM_HOURS * 3600000000UL) {
+        emulator.set_co2(++co2);
+        int16_t value;
+        bool ok = sensor.get_co2(&value);
+        count_reading(r, ok, value, co2);
+        next += SAMPLE_PERIOD;
+        long sleep_ms = (long)(next - cm1106_millis());
+        if (sleep_ms > 0) {
+            virtual_clock.advance((uint64_t)sleep_ms * 1000);
+            r.sleep_us += (uint64_t)sleep_ms * 1000;
+            r.wakes++;
+        }
+    }
+
+    r.elapsed_us = cm1106_micros() - start;
+    r.sensor_us = r.elapsed_us;
+    return r;
+}
+
+
+/* Duty cycle of CM1106_LowPower: sensor in single measurement mode, powered only while measuring */
+Result run_duty_cycle() {
+    Result r = {};
+    CM1106_LowPower lowpower(sensor, SAMPLE_PERIOD);
+    CM1106_reading reading;
+    int16_t co2 = 600;
+
+    lowpower.set_trigger(sensor_enable);
+    lowpower.set_measure_time(MEASURE_TIME);
+    emulator.set_measure_time(MEASURE_TIME * 1000UL);
+    sensor_on_us = 0;
+
+    unsigned long start = cm1106_micros();
+    if (!lowpower.begin()) {
+        printf("Single measurement mode not set!\n");
+        return r;
+    }
+
+    while (cm1106_micros() - start < SIM_HOURS * 3600000000UL) {
+        if (lowpower.get_state() == CM1106_LP_SLEEP && lowpower.get_sleep_time() == 0) {
+            emulator.set_co2(++co2);
+        }
+        if (lowpower.run() && lowpower.get_reading(&reading)) {
+            count_reading(r, reading.status == CM1106_READING_OK, reading.co2, co2);
+        }
+        uint32_t sleep_ms = lowpower.get_sleep_time();
+        if (sleep_ms > 0) {
+            virtual_clock.advance((uint64_t)sleep_ms * 1000);
+            r.sleep_us += (uint64_t)sleep_ms * 1000;
+            r.wakes++;
+        }
+    }
+
+    r.elapsed_us = cm1106_micros() - start;
+    r.sensor_us = sensor_on_us;
+
+    printf("Duty cycle: %u measurements, %u periods missed, %.3f ms in run() per reading\n\n",
+           emulator.get_measurements(), lowpower.get_missed(), lowpower.get_awake_time() / 1000.0 / (r.readings > 0 ? r.readings : 1));
+    return r;
+}
+
+
+int main() {
+    cm1106_set_clock(&virtual_clock);
+
+    printf("%u h of emulated time, one reading each %u s, measurement time %u ms\n\n", SIM_HOURS, SAMPLE_PERIOD / 1000, MEASURE_TIME);
+
+    Result polling = run_polling();
+    Result blocking = run_blocking_sleep();
+    Result duty = run_duty_cycle();
+
+    printf("%-22s %8s %6s %6s %12s %8s %10s %10s %10s\n", "Scenario", "Readings", "Errors", "Stale",
+           "Awake/read", "Awake", "Host", "Sensor", "Total");
+    printf("%-22s %8s %6s %6s %12s %8s %10s %10s %10s\n", "", "", "", "", "(ms)", "(%)", "(mJ/read)", "(mJ/read)", "(mJ/read)");
+    print_result("Polling, awake", polling);
+    print_result("Blocking read + sleep", blocking);
+    print_result("Duty cycle", duty);
+
+    return 0;
+}
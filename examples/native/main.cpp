@@ -0,0 +1,565 @@
+/*
+    Run CM1106 Library on a host computer against the emulated sensor
+*/
+
+#include <Arduino.h>
+#include "cm1106_uart.h"
+#include "cm1106_commands.h"
+#include "cm1106_emulator.h"
+#include "cm1106_acquisition.h"
+#include "cm1106_bus.h"
+#include "cm1106_filter.h"
+#include "cm1106_config.h"
+#include "cm1106_health.h"
+#include "cm1106_virtual_clock.h"
+#include <thread>
+#include <chrono>
+
+
+/* Failed checks, exit status of the program */
+static int failures = 0;
+
+void check(bool ok, const char *what) {
+    if (!ok) {
+        Serial.printf("FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+
+/* Run all commands against an emulated sensor */
+void run_commands(CM1106_Emulator &emulator) {
+    CM1106_UART sensor_CM1106(emulator);
+    CM1106_sensor sensor;
+    CM1106_ABC abc;
+    int16_t period;
+    uint8_t smoothed, mode;
+
+    sensor_CM1106.get_software_version(sensor.softver);
+    Serial.printf("Software version: %s\n", sensor.softver);
+    sensor_CM1106.get_serial_number(sensor.sn);
+    Serial.printf("Serial number: %s\n", sensor.sn);
+
+    Serial.printf("Set ABC: %d\n", sensor_CM1106.set_ABC(CM1106_ABC_OPEN, 7, 415));
+    if (sensor_CM1106.get_ABC(&abc)) {
+        Serial.printf("ABC: open/close %d, cycle %d, base %d\n", abc.open_close, abc.cycle, abc.base);
+    }
+
+    Serial.printf("Start calibration: %d\n", sensor_CM1106.start_calibration(400));
+    sensor.co2 = sensor_CM1106.get_co2();
+    Serial.printf("CO2 value: %d ppm\n", sensor.co2);
+    check(sensor.co2 > 0, "CO2 reading");
+
+    Serial.printf("Set measurement period: %d\n", sensor_CM1106.set_measurement_period(60, 2));
+    if (sensor_CM1106.get_measurement_period(&period, &smoothed)) {
+        Serial.printf("Measurement period: %d s, smoothed %d\n", period, smoothed);
+    }
+    Serial.printf("Set working status: %d\n", sensor_CM1106.set_working_status(CM1106_SINGLE_MEASUREMENT));
+    if (sensor_CM1106.get_working_status(&mode)) {
+        Serial.printf("Working status: %d\n", mode);
+    }
+    Serial.printf("Store ABC data: %d\n", sensor_CM1106.store_ABC_data());
+}
+
+
+/* Boot: detect sensor and model, then first reading */
+void run_probe(CM1106_Emulator &emulator, uint8_t expected) {
+    static const char *models[] = {"none", "unknown", "CM1106", "CM1106SL-N(S)"};
+    CM1106_UART sensor_CM1106(emulator);
+    CM1106_sensor sensor;
+
+    unsigned long start = micros();
+    uint8_t model = sensor_CM1106.probe(&sensor);
+    unsigned long probed = micros();
+    bool read = sensor_CM1106.get_co2(&sensor.co2);
+
+    Serial.printf("Probe: %s, version %s, serial number %s (%lu ms), first reading %d after %lu ms\n",
+                  models[model], sensor.softver, sensor.sn, (probed - start) / 1000, read ? sensor.co2 : 0, (micros() - start) / 1000);
+    Serial.printf("Measurement period supported: %d\n", sensor_CM1106.is_supported(CM1106_CMD_MEASUREMENT_PERIOD));
+    check(model == expected, "model detected by probe");
+    check(read == (model != CM1106_MODEL_NONE), "first reading after probe");
+}
+
+
+/* Serve metadata from cache */
+void run_cache(CM1106_Emulator &emulator) {
+    CM1106_UART sensor_CM1106(emulator);
+    CM1106_sensor sensor;
+    CM1106_ABC abc;
+
+    sensor_CM1106.enable_cache(true);
+    uint8_t cached = sensor_CM1106.refresh();
+    Serial.printf("Cached items: 0x%02x\n", cached);
+    check(cached == CM1106_CACHE_ALL, "all metadata cached");
+
+    uint32_t requests = emulator.get_requests();
+    for (int i = 0; i < 10; i++) {
+        sensor_CM1106.get_serial_number(sensor.sn);
+        sensor_CM1106.get_software_version(sensor.softver);
+        sensor_CM1106.get_ABC(&abc);
+    }
+    Serial.printf("Requests for 10 heartbeats: %u\n", (unsigned)(emulator.get_requests() - requests));
+    check(emulator.get_requests() == requests, "metadata served from cache");
+
+    sensor_CM1106.set_ABC(CM1106_ABC_CLOSE, 7, 415);
+    sensor_CM1106.get_ABC(&abc);
+    Serial.printf("ABC after setting: open/close %d (%u requests)\n", abc.open_close, (unsigned)(emulator.get_requests() - requests));
+    check(abc.open_close == CM1106_ABC_CLOSE && emulator.get_requests() - requests == 2, "ABC read again after setting");
+}
+
+
+/* Apply desired settings at each boot: only settings that differ are written */
+void run_config(CM1106_Emulator &emulator) {
+    CM1106_Config config;
+
+    config.set_ABC(CM1106_ABC_OPEN, 7, 415);
+    config.set_measurement_period(60, 2);
+    config.set_working_status(CM1106_CONTINUOUS_MEASUREMENT);
+
+    for (int boot = 1; boot <= 3; boot++) {
+        CM1106_UART sensor_CM1106(emulator);
+        uint32_t requests = emulator.get_requests();
+        uint32_t writes = emulator.get_config_writes();
+
+        bool result = config.apply(sensor_CM1106);
+        Serial.printf("Boot %d: apply %d, written 0x%02x, failed 0x%02x (%u requests, %u settings written)\n",
+                      boot, result, config.get_written(), config.get_failed(),
+                      (unsigned)(emulator.get_requests() - requests), (unsigned)(emulator.get_config_writes() - writes));
+        if (boot == 2) {
+            check(emulator.get_config_writes() == writes, "settings already applied not written again");
+        }
+
+        // Another device changed the measurement period
+        if (boot == 2) {
+            sensor_CM1106.set_measurement_period(20, 1);
+        }
+    }
+}
+
+
+/* Sample in background thread and read values without touching the serial port */
+void run_acquisition(CM1106_Emulator &emulator) {
+    CM1106_UART sensor_CM1106(emulator);
+    CM1106_Acquisition acquisition(sensor_CM1106, 50);
+    CM1106_reading reading;
+
+    acquisition.start();
+    for (int i = 0; i < 5; i++) {
+        delay(60);
+        if (acquisition.get_latest(&reading)) {
+            Serial.printf("Latest: %d ppm at %u ms\n", reading.co2, (unsigned)reading.timestamp);
+        }
+    }
+    acquisition.stop();
+
+    int count = 0;
+    while (acquisition.pop(&reading)) {
+        count++;
+    }
+    Serial.printf("History: %d readings, %u lost\n", count, (unsigned)acquisition.get_overruns());
+}
+
+
+/* Share the sensor between two threads without external lock */
+void run_shared(CM1106_Emulator &emulator) {
+    CM1106_UART sensor_CM1106(emulator);
+    int errors_co2 = 0, errors_abc = 0;
+
+    std::thread co2_thread([&]() {
+        for (int i = 0; i < 50; i++) {
+            if (sensor_CM1106.get_co2() == 0) {
+                errors_co2++;
+            }
+        }
+    });
+    std::thread abc_thread([&]() {
+        CM1106_ABC abc;
+        for (int i = 0; i < 50; i++) {
+            if (!sensor_CM1106.get_ABC(&abc)) {
+                errors_abc++;
+            }
+        }
+    });
+    co2_thread.join();
+    abc_thread.join();
+
+    Serial.printf("Shared sensor: %d CO2 errors, %d ABC errors\n", errors_co2, errors_abc);
+    check(errors_co2 == 0 && errors_abc == 0, "sensor shared between threads");
+}
+
+
+/* Probe supported commands once, then skip unsupported ones without bus traffic */
+void run_capabilities(CM1106_Emulator &emulator) {
+    CM1106_UART sensor_CM1106(emulator);
+    CM1106_capabilities caps;
+
+    unsigned long start_ms = millis();
+    sensor_CM1106.probe_capabilities(&caps);
+    Serial.printf("Capabilities of %s: 0x%04x in %lu ms\n", caps.softver, caps.commands, millis() - start_ms);
+
+    // Capabilities saved by the caller are applied to a new driver
+    CM1106_UART other(emulator);
+    bool applied = other.set_capabilities(&caps);
+    Serial.printf("Saved capabilities applied: %d\n", applied);
+    check(applied, "saved capabilities applied");
+
+    uint32_t requests = emulator.get_requests();
+    start_ms = millis();
+    int16_t period;
+    uint8_t smoothed;
+    bool result = other.get_measurement_period(&period, &smoothed);
+    Serial.printf("Get measurement period: %d in %lu ms, %u requests\n", result, millis() - start_ms, (unsigned)(emulator.get_requests() - requests));
+
+    // Garbled answers while probing do not disable commands
+    CM1106_capabilities noisy;
+    emulator.set_corrupt_rate(50);
+    sensor_CM1106.probe_capabilities(&noisy);
+    emulator.set_corrupt_rate(0);
+    Serial.printf("Capabilities with noisy line: 0x%04x\n", noisy.commands);
+    check(noisy.commands == caps.commands, "capabilities with noisy line");
+}
+
+
+/* Read several sensors one after another and at the same time */
+void run_bus() {
+    const int nb = 6;
+    CM1106_Emulator emulators[nb];
+    CM1106_UART *sensors[nb];
+    CM1106_Bus bus;
+    CM1106_reading readings[CM1106_BUS_MAX];
+
+    for (int i = 0; i < nb; i++) {
+        emulators[i].set_latency(2000 + 1000 * i);
+        emulators[i].set_co2(400 + 10 * i);
+        sensors[i] = new CM1106_UART(emulators[i]);
+        bus.add(*sensors[i]);
+    }
+
+    unsigned long start_us = micros();
+    for (int i = 0; i < nb; i++) {
+        sensors[i]->get_co2();
+    }
+    Serial.printf("Sequential reading of %d sensors: %lu us\n", nb, micros() - start_us);
+
+    start_us = micros();
+    uint8_t valid = bus.sweep(readings);
+    Serial.printf("Bus sweep of %d sensors: %lu us, %d valid (", nb, micros() - start_us, valid);
+    for (int i = 0; i < nb; i++) {
+        Serial.printf(" %d", readings[i].co2);
+    }
+    Serial.println(" ppm)");
+    check(valid == nb, "readings of bus sweep");
+
+    for (int i = 0; i < nb; i++) {
+        delete sensors[i];
+    }
+}
+
+
+/* Filter readings of each sensor of a bus: spikes rejected, noise smoothed, errors marked */
+void run_filters() {
+    const int nb = 2;
+    CM1106_VirtualClock virtual_clock;
+    cm1106_set_clock(&virtual_clock);
+
+    CM1106_Emulator emulators[nb];
+    CM1106_UART *sensors[nb];
+    CM1106_OutlierGate gates[nb] = {CM1106_OutlierGate(50, 100), CM1106_OutlierGate(50, 100)};
+    CM1106_Median<5> medians[nb];
+    CM1106_EMA emas[nb] = {CM1106_EMA(2), CM1106_EMA(2)};
+    CM1106_Bus bus;
+    CM1106_reading readings[CM1106_BUS_MAX];
+
+    for (int i = 0; i < nb; i++) {
+        sensors[i] = new CM1106_UART(emulators[i]);
+        bus.add(*sensors[i]);
+        gates[i].then(medians[i]).then(emas[i]);
+        bus.set_filter(i, &gates[i]);
+    }
+
+    // Slow rise with noise, spikes and a sensor not answering, one sweep each 10 s
+    uint32_t noise = 1106;
+    int rejected = 0, errors = 0, raw_error = 0, filtered_error = 0;
+    for (int t = 0; t < 360; t++) {
+        int16_t level = 500 + t;
+        for (int i = 0; i < nb; i++) {
+            noise = noise * 1103515245 + 12345;
+            int16_t raw = level + (int16_t)((noise >> 16) % 41) - 20;
+            if (t % 37 == 36) {
+                raw += 1500;
+            }
+            if (raw - level > raw_error) {
+                raw_error = raw - level;
+            }
+            emulators[i].set_co2(raw);
+            emulators[i].set_silent(t % 50 == 49);
+        }
+        bus.sweep(readings);
+        for (int i = 0; i < nb; i++) {
+            if (readings[i].status == CM1106_READING_REJECTED) {
+                rejected++;
+            } else if (readings[i].status != CM1106_READING_OK) {
+                errors++;
+            } else if (abs(readings[i].co2 - level) > filtered_error) {
+                filtered_error = abs(readings[i].co2 - level);
+            }
+        }
+        cm1106_delay(10000);
+    }
+    cm1106_set_clock(NULL);
+
+    Serial.printf("Filtered readings: %d rejected, %d errors, max error %d ppm (raw %d ppm)\n", rejected, errors, filtered_error, raw_error);
+    check(rejected > 0 && errors > 0 && filtered_error < 50, "filtered readings");
+
+    for (int i = 0; i < nb; i++) {
+        delete sensors[i];
+    }
+}
+
+
+/* Tight timeouts for a healthy sensor, fast failures when it is gone */
+void run_lost() {
+    CM1106_Emulator emulator(CM1106_EMU_MODEL_CM1106);
+    CM1106_UART sensor_CM1106(emulator);
+    int16_t co2;
+
+    for (int i = 0; i < 20; i++) {
+        sensor_CM1106.get_co2(&co2);
+    }
+    Serial.printf("Adaptive CO2 timeout: %u ms\n", sensor_CM1106.get_timeout(CM1106_ID_GET_CO2));
+
+    emulator.set_silent(true);
+    unsigned long start_ms = millis();
+    int errors = 0;
+    for (int i = 0; i < 20; i++) {
+        if (!sensor_CM1106.get_co2(&co2)) {
+            errors++;
+        }
+    }
+    Serial.printf("Sensor gone: %d errors in %lu ms, lost %d\n", errors, millis() - start_ms, sensor_CM1106.is_lost());
+    check(errors == 20 && sensor_CM1106.is_lost(), "sensor gone");
+
+    emulator.set_silent(false);
+    bool result = sensor_CM1106.get_co2(&co2);
+    Serial.printf("Sensor back: %d, lost %d\n", result, sensor_CM1106.is_lost());
+    check(result && !sensor_CM1106.is_lost(), "sensor back");
+}
+
+
+/* A week of operation on a virtual clock: the sensor drifts until ABC corrects it */
+void run_week() {
+    CM1106_VirtualClock virtual_clock;
+    cm1106_set_clock(&virtual_clock);
+
+    CM1106_Emulator emulator(CM1106_EMU_MODEL_CM1106);
+    CM1106_UART sensor_CM1106(emulator);
+    emulator.set_drift(-6);
+    sensor_CM1106.set_ABC(CM1106_ABC_OPEN, 7, 400);
+
+    auto real_start = std::chrono::steady_clock::now();
+    int readings = 0;
+    for (int day = 1; day <= 8; day++) {
+        int16_t night = INT16_MAX;
+        int16_t co2;
+
+        // One reading each 10 minutes: fresh air (400 ppm) at night, occupied room at day
+        for (int slot = 0; slot < 144; slot++) {
+            emulator.set_co2(slot < 36 ? 400 : 750);
+            if (sensor_CM1106.get_co2(&co2)) {
+                readings++;
+                if (slot < 36 && co2 < night) {
+                    night = co2;
+                }
+            }
+            cm1106_delay(600000);
+        }
+        Serial.printf("Day %d: night %d ppm, ABC correction %d ppm\n", day, night, emulator.get_abc_offset());
+    }
+    long real_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - real_start).count();
+
+    cm1106_set_clock(NULL);
+    Serial.printf("%d readings in %lu h of sensor time, %ld ms of real time\n", readings, (unsigned long)(virtual_clock.get_time() / 3600000000ULL), real_ms);
+    check(readings == 8 * 144 && emulator.get_abc_offset() < 0, "drift corrected by ABC");
+}
+
+
+/* Print changes of health */
+void health_changed(CM1106_Health &health, uint8_t previous) {
+    static const char *states[] = {"healthy", "degraded", "lost", "recovering"};
+
+    Serial.printf("    %5lu s: %s -> %s\n", (unsigned long)(cm1106_millis() / 1000), states[previous], states[health.get_state()]);
+}
+
+
+/* An hour of readings each 10 s: noisy line, then sensor gone for 25 minutes and back with factory settings,
+   return requests sent while sensor is gone */
+uint32_t run_health(bool watched) {
+    CM1106_VirtualClock virtual_clock;
+    cm1106_set_clock(&virtual_clock);
+
+    CM1106_Emulator emulator(CM1106_EMU_MODEL_CM1106);
+    CM1106_UART sensor_CM1106(emulator);
+    CM1106_Health health(sensor_CM1106);
+    CM1106_Config config;
+
+    config.set_ABC(CM1106_ABC_OPEN, 7, 415);
+    config.apply(sensor_CM1106);
+    health.set_config(&config);
+    health.set_callback(health_changed);
+
+    uint32_t outage_requests = 0;
+    uint64_t outage_us = 0;
+    int valid = 0;
+    for (int slot = 0; slot < 360; slot++) {
+        bool outage = (slot >= 90 && slot < 240);
+        emulator.set_garbage_rate(slot >= 60 && slot < 63 ? 100 : 0);
+        emulator.set_corrupt_rate(slot >= 60 && slot < 63 ? 100 : 0);
+        emulator.set_silent(outage);
+        if (slot == 240) {
+            CM1106_UART installer(emulator);
+            installer.set_ABC(CM1106_ABC_CLOSE, 7, 400);
+        }
+
+        uint32_t requests = emulator.get_requests();
+        uint64_t start = virtual_clock.get_time();
+        bool ok;
+        if (watched) {
+            CM1106_reading reading;
+            ok = health.get_co2(&reading);
+        } else {
+            int16_t co2;
+            ok = sensor_CM1106.get_co2(&co2);
+        }
+        if (outage) {
+            outage_requests += emulator.get_requests() - requests;
+            outage_us += virtual_clock.get_time() - start;
+        }
+        if (ok) {
+            valid++;
+        }
+        cm1106_delay(10000 - (uint32_t)((virtual_clock.get_time() - start) / 1000));
+    }
+
+    CM1106_ABC abc;
+    sensor_CM1106.get_ABC(&abc);
+    cm1106_set_clock(NULL);
+
+    Serial.printf("%s: %d valid readings, %u requests and %lu ms in requests while sensor gone, ABC %s after return\n",
+                  watched ? "With health" : "Without health", valid, (unsigned)outage_requests, (unsigned long)(outage_us / 1000),
+                  abc.open_close == CM1106_ABC_OPEN ? "open" : "closed");
+    if (watched) {
+        check(abc.open_close == CM1106_ABC_OPEN, "settings applied again after return of sensor");
+    } else {
+        check(abc.open_close == CM1106_ABC_CLOSE, "settings left as found after return of sensor without health");
+    }
+
+    return outage_requests;
+}
+
+
+/* Line noise looking like the start of a long frame, then the response: taken at once */
+void run_noise(CM1106_Emulator &emulator) {
+    static const uint8_t noise[] = {0x16, 0x11};
+    CM1106_UART sensor_CM1106(emulator);
+    int16_t co2 = 0;
+
+    uint32_t requests = emulator.get_requests();
+    emulator.inject_noise(noise, sizeof(noise));
+    bool result = sensor_CM1106.get_co2(&co2);
+    Serial.printf("Reading after noise 16 11: %d, %d ppm (%u requests)\n", result, co2, (unsigned)(emulator.get_requests() - requests));
+    check(result && emulator.get_requests() - requests == 1, "response after line noise taken without retry");
+}
+
+
+/* Read CO2 values with faults in the communication */
+void run_faults(CM1106_Emulator &emulator, int count) {
+    CM1106_UART sensor_CM1106(emulator);
+    int ok = 0;
+
+    unsigned long start_ms = millis();
+    for (int i = 0; i < count; i++) {
+        if (sensor_CM1106.get_co2() != 0) {
+            ok++;
+        }
+    }
+    Serial.printf("Valid readings: %d/%d in %lu ms\n", ok, count, millis() - start_ms);
+    check(ok > count / 2, "readings with noisy line");
+
+#ifdef CM1106_STATS
+    CM1106_stats stats;
+    sensor_CM1106.get_stats(&stats);
+    Serial.printf("Requests: %u, timeouts: %u, short frames: %u, checksum errors: %u, NAKs: %u, resyncs: %u\n",
+                  (unsigned)stats.transactions[CM1106_ID_GET_CO2], (unsigned)stats.timeouts, (unsigned)stats.short_frames,
+                  (unsigned)stats.checksum_errors, (unsigned)stats.naks, (unsigned)stats.resyncs);
+    Serial.printf("Bytes TX/RX: %u/%u, latency (ms) <10:%u <15:%u <20:%u <30:%u <50:%u <100:%u <200:%u >=200:%u\n",
+                  (unsigned)stats.bytes_tx, (unsigned)stats.bytes_rx,
+                  (unsigned)stats.latency[0], (unsigned)stats.latency[1], (unsigned)stats.latency[2], (unsigned)stats.latency[3],
+                  (unsigned)stats.latency[4], (unsigned)stats.latency[5], (unsigned)stats.latency[6], (unsigned)stats.latency[7]);
+    check(stats.transactions[CM1106_ID_GET_CO2] >= (uint32_t)count && stats.bytes_tx == 4 * stats.transactions[CM1106_ID_GET_CO2],
+          "requests counted");
+    check(stats.timeouts + stats.short_frames > 0 && stats.checksum_errors > 0 && stats.naks > 0 && stats.resyncs > 0,
+          "faults counted");
+    check(stats.bytes_rx >= 8 * (uint32_t)ok, "received bytes counted");
+#endif
+}
+
+
+int main() {
+
+    Serial.println(">>> CM1106 <<<");
+    CM1106_Emulator cm1106(CM1106_EMU_MODEL_CM1106);
+    run_probe(cm1106, CM1106_MODEL_CM1106);
+    run_commands(cm1106);
+    run_capabilities(cm1106);
+    run_config(cm1106);
+
+    Serial.println(">>> CM1106SL-NS <<<");
+    CM1106_Emulator cm1106sl(CM1106_EMU_MODEL_SL_NS);
+    run_probe(cm1106sl, CM1106_MODEL_SL_N);
+    run_commands(cm1106sl);
+    run_capabilities(cm1106sl);
+    run_cache(cm1106sl);
+    run_config(cm1106sl);
+    run_acquisition(cm1106sl);
+    run_shared(cm1106sl);
+
+    Serial.println(">>> Several CM1106 <<<");
+    run_bus();
+    run_filters();
+
+    Serial.println(">>> CM1106 with noisy line <<<");
+    run_noise(cm1106);
+    CM1106_Emulator noisy(CM1106_EMU_MODEL_CM1106);
+    noisy.set_seed(1106);
+    noisy.set_jitter(200);
+    noisy.set_garbage_rate(20);
+    noisy.set_corrupt_rate(10);
+    noisy.set_split_rate(10);
+    noisy.set_truncate_rate(5);
+    noisy.set_nak_rate(5);
+    run_faults(noisy, 50);
+
+    Serial.println(">>> CM1106 disconnected <<<");
+    CM1106_Emulator absent(CM1106_EMU_MODEL_CM1106);
+    absent.set_silent(true);
+    run_probe(absent, CM1106_MODEL_NONE);
+    uint32_t unwatched = run_health(false);
+    uint32_t watched = run_health(true);
+    check(watched < unwatched / 2, "lost sensor only probed with health");
+    run_lost();
+
+    Serial.println(">>> CM1106 for a week <<<");
+    run_week();
+
+#ifdef CM1106_LOG_DEFERRED
+    // Last records of the debug log, decoded by extras/tools/cm1106_log_decode.py
+    Serial.printf("Deferred log (%u records overwritten):\n", (unsigned)cm1106_log_dropped());
+    cm1106_log_dump(Serial);
+#endif
+
+    if (failures > 0) {
+        Serial.printf("%d checks failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
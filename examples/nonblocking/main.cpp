@@ -0,0 +1,69 @@
+#include <Arduino.h>
+#include "cm1106_uart.h"
+
+
+#ifdef USE_SOFTWARE_SERIAL
+    // Modify if CM1106 is connected using softwareserial
+    #define CM1106_RX_PIN 14                                   // Rx pin which the CM1106 Tx pin is attached to
+    #define CM1106_TX_PIN 12                                   // Tx pin which the CM1106 Rx pin is attached to
+    SoftwareSerial CM1106_serial(CM1106_RX_PIN, CM1106_TX_PIN);
+#else
+    // Modify if CM1106 is attached to a hardware port
+    #define CM1106_serial Serial2
+#endif
+
+#ifdef NODEMCUV2
+    #define CONSOLE_BAUDRATE 74880
+#else    
+    #define CONSOLE_BAUDRATE 115200
+#endif    
+
+#define READ_INTERVAL 5000                                     // Time between CO2 readings (ms)
+
+
+CM1106_UART *sensor_CM1106;
+unsigned long last_request = 0;
+unsigned long loop_count = 0;
+
+
+void setup() {
+
+    // Initialize console serial communication
+    Serial.begin(CONSOLE_BAUDRATE);
+    Serial.println("");
+
+    Serial.println("Init");
+
+    // Initialize sensor
+    CM1106_serial.begin(CM1106_BAUDRATE);
+    sensor_CM1106 = new CM1106_UART(CM1106_serial);
+
+    Serial.println("Setup done!");
+}
+
+
+void loop() {
+
+    // Ask a new CO2 value without waiting the response
+    if (millis() - last_request >= READ_INTERVAL) {
+        if (sensor_CM1106->begin_get_co2()) {
+            last_request = millis();
+            loop_count = 0;
+        }
+    }
+
+    // Check if the response is complete, it only takes the bytes already received
+    switch (sensor_CM1106->poll()) {
+        case CM1106_POLL_READY:
+            Serial.printf("CO2 value: %d ppm (%lu loops while waiting)\n", sensor_CM1106->get_last_co2(), loop_count);
+            break;
+        case CM1106_POLL_ERROR:
+            Serial.println("Error getting CO2 value!");
+            break;
+        default:
+            break;
+    }
+
+    // The rest of the firmware keeps running here
+    loop_count++;
+}
@@ -0,0 +1,150 @@
+/*
+    Record the UART traffic of CM1106 Library and play it back
+
+    A session with a noisy emulated sensor is captured to a file, then replayed with its original
+    timing and as fast as possible from the mapped file. A long capture recorded on a virtual
+    clock measures replay throughput. Given a capture as argument, it is replayed as fast as possible.
+*/
+
+#include <Arduino.h>
+#include <chrono>
+#include <vector>
+#include "cm1106_uart.h"
+#include "cm1106_capture.h"
+#include "cm1106_emulator.h"
+#include "cm1106_capture_file.h"
+#include "cm1106_virtual_clock.h"
+
+#define CAPTURE_PATH  "/tmp/cm1106_capture.bin"
+#define FLEET_PATH    "/tmp/cm1106_fleet.bin"
+#define SESSION_READINGS       100     // Readings of recorded session
+#define FLEET_READINGS      200000     // Readings of long capture
+
+
+/* Real time (ms) */
+static double real_ms() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+/* Readings of a session, until end of replayed capture */
+std::vector<int16_t> run_session(Stream &serial, int count, CM1106_Replay *player = NULL) {
+    CM1106_UART sensor_CM1106(serial);
+    std::vector<int16_t> values;
+    CM1106_ABC abc;
+
+    // Fixed timeouts: a few ms of scheduling in replay do not change decisions of the driver
+    sensor_CM1106.set_adaptive_timeout(false);
+
+    for (int i = 0; i < count && (player == NULL || !player->is_finished()); i++) {
+        values.push_back(sensor_CM1106.get_co2());
+        if (i % 25 == 0) {
+            values.push_back(sensor_CM1106.get_ABC(&abc) ? abc.cycle : -1);
+        }
+    }
+    return values;
+}
+
+
+/* Failed checks, exit status of the program */
+static int failures = 0;
+
+void check(bool ok, const char *what) {
+    if (!ok) {
+        printf("FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+
+/* Replay a capture from the mapped file */
+std::vector<int16_t> replay(const char *path, bool realtime, int count) {
+    CM1106_CaptureFile file;
+    std::vector<int16_t> values;
+
+    if (!file.map(path)) {
+        printf("Capture %s not found!\n", path);
+        failures++;
+        return values;
+    }
+
+    CM1106_Replay player(file.get_data(), file.get_size());
+    player.set_realtime(realtime);
+    if (!player.is_valid()) {
+        printf("Invalid capture!\n");
+        failures++;
+        return values;
+    }
+
+    double start = real_ms();
+    values = run_session(player, count, &player);
+    double elapsed = real_ms() - start;
+
+    printf("Replay %s: %.0f ms, %zu bytes, %.0f readings/s, %.1f MB/s, finished %d, mismatches %u, skipped %u\n",
+           realtime ? "original timing" : "as fast as possible", elapsed, file.get_size(), values.size() / elapsed * 1000,
+           file.get_size() / elapsed / 1000, player.is_finished(), player.get_mismatches(), player.get_skipped());
+    check(player.get_mismatches() == 0, "requests of the driver differ from the capture");
+    return values;
+}
+
+
+/* Capture a session of a sensor */
+std::vector<int16_t> record(const char *path, CM1106_Emulator &emulator, int count) {
+    CM1106_CaptureFile file;
+    std::vector<int16_t> values;
+
+    if (!file.create(path)) {
+        return values;
+    }
+    CM1106_Capture capture(emulator, file);
+    capture.begin();
+
+    double start = real_ms();
+    values = run_session(capture, count);
+    capture.flush();
+    printf("Recorded %d readings: %.0f ms, %u records\n", count, real_ms() - start, (unsigned)capture.get_records());
+    return values;
+}
+
+
+int main(int argc, char *argv[]) {
+
+    if (argc > 1) {
+        replay(argv[1], false, INT32_MAX / 2);
+        return failures > 0 ? 1 : 0;
+    }
+
+    // Session with faults
+    CM1106_Emulator noisy(CM1106_EMU_MODEL_CM1106);
+    noisy.set_seed(1106);
+    noisy.set_jitter(200);
+    noisy.set_garbage_rate(5);
+    noisy.set_corrupt_rate(5);
+    noisy.set_nak_rate(5);
+    std::vector<int16_t> recorded = record(CAPTURE_PATH, noisy, SESSION_READINGS);
+
+    std::vector<int16_t> timed = replay(CAPTURE_PATH, true, SESSION_READINGS);
+    printf("Same values: %d\n", timed == recorded);
+    check(timed == recorded, "values of replay with original timing");
+    std::vector<int16_t> fast = replay(CAPTURE_PATH, false, SESSION_READINGS);
+    printf("Same values: %d\n\n", fast == recorded);
+    check(fast == recorded, "values of replay as fast as possible");
+
+    // Long capture recorded on virtual time
+    CM1106_VirtualClock virtual_clock;
+    virtual_clock.set_tick(50);
+    cm1106_set_clock(&virtual_clock);
+    CM1106_Emulator fleet(CM1106_EMU_MODEL_CM1106);
+    recorded = record(FLEET_PATH, fleet, FLEET_READINGS);
+    cm1106_set_clock(NULL);
+
+    fast = replay(FLEET_PATH, false, FLEET_READINGS);
+    printf("Same values: %d\n", fast == recorded);
+    check(fast == recorded, "values of replay of long capture");
+
+    if (failures > 0) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
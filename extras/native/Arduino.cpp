@@ -0,0 +1,144 @@
+/*
+    Minimal Arduino API for native (host) builds of CM1106 Library
+*/
+
+
+#include "Arduino.h"
+
+#include <chrono>
+#include <thread>
+
+NativeSerial Serial;
+
+static const std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+
+
+/* Milliseconds since start */
+unsigned long millis() {
+    return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time).count();
+}
+
+
+/* Microseconds since start */
+unsigned long micros() {
+    return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+}
+
+
+/* Wait milliseconds */
+void delay(unsigned long ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+
+/* Wait microseconds */
+void delayMicroseconds(unsigned int us) {
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+
+/* Let other threads run */
+void yield() {
+    std::this_thread::yield();
+}
+
+
+/* Write buffer byte by byte */
+size_t Print::write(const uint8_t *buffer, size_t size) {
+    size_t n = 0;
+    while (n < size && write(buffer[n])) {
+        n++;
+    }
+    return n;
+}
+
+
+size_t Print::print(const char str[]) {
+    return write((const uint8_t *)str, strlen(str));
+}
+
+
+size_t Print::print(long value) {
+    return printf("%ld", value);
+}
+
+
+size_t Print::println(const char str[]) {
+    return print(str) + print("\n");
+}
+
+
+size_t Print::println(long value) {
+    return print(value) + print("\n");
+}
+
+
+size_t Print::printf(const char *format, ...) {
+    char buf[256];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    if (len < 0) {
+        return 0;
+    }
+    if ((size_t)len >= sizeof(buf)) {
+        len = sizeof(buf) - 1;
+    }
+    return write((const uint8_t *)buf, len);
+}
+
+
+void Stream::setTimeout(unsigned long timeout) {
+    _timeout = timeout;
+}
+
+
+/* Read bytes waiting up to timeout between them */
+size_t Stream::readBytes(uint8_t *buffer, size_t length) {
+    size_t n = 0;
+    unsigned long start_ms = millis();
+    while (n < length && millis() - start_ms < _timeout) {
+        int c = read();
+        if (c >= 0) {
+            buffer[n++] = (uint8_t)c;
+            start_ms = millis();
+        }
+    }
+    return n;
+}
+
+
+void NativeSerial::begin(unsigned long baudrate) {
+    (void)baudrate;
+}
+
+
+int NativeSerial::available() {
+    return 0;
+}
+
+
+int NativeSerial::read() {
+    return -1;
+}
+
+
+int NativeSerial::peek() {
+    return -1;
+}
+
+
+size_t NativeSerial::write(uint8_t data) {
+    return fputc(data, stdout) == EOF ? 0 : 1;
+}
+
+
+size_t NativeSerial::write(const uint8_t *buffer, size_t size) {
+    return fwrite(buffer, 1, size, stdout);
+}
+
+
+void NativeSerial::flush() {
+    fflush(stdout);
+}
@@ -0,0 +1,73 @@
+/*
+    Minimal Arduino API for native (host) builds of CM1106 Library
+
+    Only the parts used by the library, the examples and the emulator are
+    implemented: time functions, Print/Stream and a Serial console on stdout.
+*/
+
+
+#ifndef _CM1106_NATIVE_ARDUINO
+    #define _CM1106_NATIVE_ARDUINO
+
+    #include <stdint.h>
+    #include <stddef.h>
+    #include <stdio.h>
+    #include <stdlib.h>
+    #include <string.h>
+    #include <stdarg.h>
+
+    unsigned long millis();                                                     // Milliseconds since start
+    unsigned long micros();                                                     // Microseconds since start
+    void delay(unsigned long ms);                                               // Wait milliseconds
+    void delayMicroseconds(unsigned int us);                                    // Wait microseconds
+    void yield();                                                               // Let other threads run
+
+
+    class Print
+    {
+        public:
+            virtual ~Print() {}
+            virtual size_t write(uint8_t data) = 0;
+            virtual size_t write(const uint8_t *buffer, size_t size);
+            virtual void flush() {}
+
+            size_t print(const char str[]);
+            size_t print(long value);
+            size_t println(const char str[] = "");
+            size_t println(long value);
+            size_t printf(const char *format, ...) __attribute__ ((format (printf, 2, 3)));
+    };
+
+
+    class Stream : public Print
+    {
+        public:
+            virtual int available() = 0;
+            virtual int read() = 0;
+            virtual int peek() = 0;
+
+            void setTimeout(unsigned long timeout);
+            size_t readBytes(uint8_t *buffer, size_t length);
+
+        protected:
+            unsigned long _timeout = 1000;
+    };
+
+
+    /* Console on stdout/stdin */
+    class NativeSerial : public Stream
+    {
+        public:
+            void begin(unsigned long baudrate);
+            int available() override;
+            int read() override;
+            int peek() override;
+            size_t write(uint8_t data) override;
+            size_t write(const uint8_t *buffer, size_t size) override;
+            void flush() override;
+            using Print::write;
+    };
+
+    extern NativeSerial Serial;
+
+#endif
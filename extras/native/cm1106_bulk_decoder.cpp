@@ -0,0 +1,150 @@
+/*
+    CM1106 Library for serial communication (UART)
+
+Copyright (c) 2021 Josep Comas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include "cm1106_bulk_decoder.h"
+
+
+/* Read a varint (LEB128) */
+static inline uint32_t read_varint(const uint8_t *block, uint8_t *pos, uint8_t end) {
+    uint32_t value = 0;
+    uint8_t shift = 0;
+
+    while (*pos < end && shift < 35) {
+        uint8_t b = block[(*pos)++];
+        value |= (uint32_t)(b & 0x7F) << shift;
+        shift += 7;
+        if ((b & 0x80) == 0) {
+            break;
+        }
+    }
+    return value;
+}
+
+
+/* Initialize with size of blocks */
+CM1106_BulkDecoder::CM1106_BulkDecoder(uint8_t block_size)
+{
+    // Blocks too small for a header and a checksum are rejected, decode() returns no reading
+    this->block_size = block_size >= CM1106_CODEC_MIN_BLOCK ? block_size : 0;
+    blocks = 0;
+    invalid = 0;
+}
+
+
+/* Decode consecutive blocks */
+size_t CM1106_BulkDecoder::decode(const uint8_t *data, size_t size, uint32_t *timestamp, int16_t *co2, uint8_t *status, size_t capacity) {
+    size_t count = 0;
+
+    blocks = 0;
+    invalid = 0;
+
+    if (block_size == 0 || data == NULL) {
+        return 0;
+    }
+
+    for (size_t offset = 0; offset + block_size <= size; offset += block_size) {
+        const uint8_t *block = &data[offset];
+        uint16_t sum = cm1106_fletcher16(block, block_size - CM1106_CODEC_CHECKSUM);
+
+        if (block[0] != CM1106_CODEC_VERSION || block[1] == 0 ||
+            (int)CM1106_CODEC_HEADER + block[2] > (int)block_size - CM1106_CODEC_CHECKSUM ||
+            block[block_size - 2] != (sum & 0xFF) || block[block_size - 1] != (sum >> 8)) {
+            invalid++;
+            continue;
+        }
+        if (count + block[1] > capacity) {
+            break;
+        }
+
+        uint8_t n = parse(block, &status[count]);
+        uint32_t *t = &timestamp[count];
+        int16_t *c = &co2[count];
+
+        // Zigzag deltas to signed deltas
+        for (uint8_t i = 1; i < n; i++) {
+            time[i] = (time[i] >> 1) ^ -(time[i] & 1);
+            value[i] = (value[i] >> 1) ^ -(value[i] & 1);
+        }
+
+        // Delta of delta to delta, then deltas to values
+        uint32_t delta = 0;
+        for (uint8_t i = 1; i < n; i++) {
+            delta += time[i];
+            time[i] = delta;
+        }
+        t[0] = block[3] | ((uint32_t)block[4] << 8) | ((uint32_t)block[5] << 16) | ((uint32_t)block[6] << 24);
+        c[0] = (int16_t)(block[7] | (block[8] << 8));
+        for (uint8_t i = 1; i < n; i++) {
+            t[i] = t[i - 1] + time[i];
+            c[i] = c[i - 1] + (int16_t)value[i];
+        }
+
+        count += n;
+        blocks++;
+    }
+
+    return count;
+}
+
+
+size_t CM1106_BulkDecoder::get_blocks() {
+    return blocks;
+}
+
+
+size_t CM1106_BulkDecoder::get_invalid() {
+    return invalid;
+}
+
+
+/* Parse samples of a block to deltas */
+uint8_t CM1106_BulkDecoder::parse(const uint8_t *block, uint8_t *status) {
+    uint8_t n = block[1];
+    uint8_t end = CM1106_CODEC_HEADER + block[2];
+    uint8_t pos = CM1106_CODEC_HEADER;
+    uint8_t i;
+
+    status[0] = block[9];
+    for (i = 1; i < n && pos < end; i++) {
+        uint8_t first = block[pos++];
+        status[i] = status[i - 1];
+        if ((first & CM1106_CODEC_MEDIUM) == 0) {
+            time[i] = first >> 4;
+            value[i] = first & 0x0F;
+        } else if ((first & CM1106_CODEC_TAG) == CM1106_CODEC_MEDIUM) {
+            time[i] = first & 0x3F;
+            value[i] = pos < end ? block[pos++] : 0;
+        } else {
+            time[i] = read_varint(block, &pos, end);
+            value[i] = read_varint(block, &pos, end);
+            if ((first & CM1106_CODEC_STATUS) && pos < end) {
+                status[i] = block[pos++];
+            }
+        }
+    }
+
+    return i;
+}
@@ -0,0 +1,54 @@
+/*
+    CM1106 Library for serial communication (UART)
+
+Copyright (c) 2021 Josep Comas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/    
+
+
+#ifndef _CM1106_BULK_DECODER
+    #define _CM1106_BULK_DECODER
+
+    #include "cm1106_codec.h"
+
+
+    /* Decoder of many blocks into columns (timestamps, co2 and status in separate arrays). Each block
+       is parsed to zigzag deltas first, then decoded and summed in plain loops over arrays that the
+       compiler can vectorize. */
+    class CM1106_BulkDecoder
+    {
+        public:
+            CM1106_BulkDecoder(uint8_t block_size = CM1106_CODEC_BLOCK);       // Initialize with size of blocks (nothing decoded if smaller than CM1106_CODEC_MIN_BLOCK)
+            size_t decode(const uint8_t *data, size_t size, uint32_t *timestamp, int16_t *co2, uint8_t *status, size_t capacity);  // Decode consecutive blocks, return number of readings
+            size_t get_blocks();                                                // Get number of blocks decoded by last call
+            size_t get_invalid();                                               // Get number of invalid blocks skipped by last call
+
+        private:
+            uint8_t block_size;
+            size_t blocks;
+            size_t invalid;
+            uint32_t time[256];                                                 // Deltas of a block (zigzag, then decoded)
+            uint32_t value[256];
+
+            uint8_t parse(const uint8_t *block, uint8_t *status);              // Parse samples of a block to deltas, return number of readings
+    };
+
+#endif
@@ -0,0 +1,144 @@
+/*
+    CM1106 Library for serial communication (UART)
+
+Copyright (c) 2021 Josep Comas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include "cm1106_capture_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+/* Initialize */
+CM1106_CaptureFile::CM1106_CaptureFile()
+{
+    file = NULL;
+    empty = true;
+    fd = -1;
+    data = NULL;
+    size = 0;
+}
+
+
+CM1106_CaptureFile::~CM1106_CaptureFile() {
+    close();
+}
+
+
+/* Open file to write records */
+bool CM1106_CaptureFile::create(const char *path, bool append) {
+
+    close();
+    file = fopen(path, append ? "ab" : "wb");
+    if (file == NULL) {
+        CM1106_LOG("DEBUG: Capture file %s not opened!\n", path);
+        return false;
+    }
+    empty = (ftell(file) == 0);
+
+    return true;
+}
+
+
+bool CM1106_CaptureFile::is_empty() {
+    return empty;
+}
+
+
+/* Map file in memory, pages are read by the kernel as replay goes forward */
+bool CM1106_CaptureFile::map(const char *path) {
+    struct stat st;
+
+    close();
+    fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0) {
+        CM1106_LOG("DEBUG: Capture file %s not opened!\n", path);
+        close();
+        return false;
+    }
+
+    void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+        CM1106_LOG("DEBUG: Capture file %s not mapped!\n", path);
+        close();
+        return false;
+    }
+    madvise(addr, st.st_size, MADV_SEQUENTIAL);
+
+    data = (const uint8_t *)addr;
+    size = st.st_size;
+    return true;
+}
+
+
+/* Close file (and unmap it) */
+void CM1106_CaptureFile::close() {
+
+    if (file != NULL) {
+        fclose(file);
+        file = NULL;
+    }
+    if (data != NULL) {
+        munmap((void *)data, size);
+        data = NULL;
+        size = 0;
+    }
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+
+const uint8_t *CM1106_CaptureFile::get_data() {
+    return data;
+}
+
+
+size_t CM1106_CaptureFile::get_size() {
+    return size;
+}
+
+
+size_t CM1106_CaptureFile::write(uint8_t data) {
+    return write(&data, 1);
+}
+
+
+size_t CM1106_CaptureFile::write(const uint8_t *buffer, size_t size) {
+    if (file == NULL) {
+        return 0;
+    }
+    empty = false;
+    return fwrite(buffer, 1, size, file);
+}
+
+
+void CM1106_CaptureFile::flush() {
+    if (file != NULL) {
+        fflush(file);
+    }
+}
@@ -0,0 +1,61 @@
+/*
+    CM1106 Library for serial communication (UART)
+
+Copyright (c) 2021 Josep Comas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/    
+
+
+#ifndef _CM1106_CAPTURE_FILE
+    #define _CM1106_CAPTURE_FILE
+
+    #include "Arduino.h"
+    #include "cm1106_capture.h"
+
+
+    /* File of captures: records are appended through Print (see CM1106_Capture), and a capture
+       is mapped in memory to be played by CM1106_Replay without reading it to RAM first. */
+    class CM1106_CaptureFile : public Print
+    {
+        public:
+            CM1106_CaptureFile();                                               // Initialize
+            ~CM1106_CaptureFile();
+            bool create(const char *path, bool append = false);                 // Open file to write records (append keeps previous records)
+            bool is_empty();                                                    // Check if file opened to write has no records (header needed)
+            bool map(const char *path);                                         // Map file in memory to replay it
+            void close();                                                       // Close file (and unmap it)
+            const uint8_t *get_data();                                          // Get mapped capture
+            size_t get_size();                                                  // Get size of mapped capture
+
+            /* Print */
+            size_t write(uint8_t data) override;
+            size_t write(const uint8_t *buffer, size_t size) override;
+            void flush() override;
+
+        private:
+            FILE *file;                                                         // File opened to write
+            bool empty;
+            int fd;                                                             // File mapped in memory
+            const uint8_t *data;
+            size_t size;
+    };
+
+#endif
@@ -0,0 +1,214 @@
+/*
+    CM1106 Library for serial communication (UART)
+
+Copyright (c) 2021 Josep Comas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include "cm1106_coro.h"
+
+#if defined(__linux__) && defined(__cpp_impl_coroutine)
+
+#include "cm1106_commands.h"
+#include <unistd.h>
+
+
+/* Initialize */
+CM1106_Reactor::CM1106_Reactor()
+{
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+}
+
+
+CM1106_Reactor::~CM1106_Reactor() {
+    if (epfd >= 0) {
+        close(epfd);
+    }
+}
+
+
+/* Suspend waiter until fd is readable or deadline */
+void CM1106_Reactor::wait(CM1106_Waiter &waiter, int fd, unsigned long deadline) {
+
+    waiter.fd = fd;
+    waiter.timer = timers.emplace(deadline, &waiter);
+
+    if (fd >= 0) {
+        // One shot: the descriptor is armed again by the next wait
+        epoll_event event;
+        event.events = EPOLLIN | EPOLLONESHOT;
+        event.data.fd = fd;
+        auto reader = readers.find(fd);
+        if (reader == readers.end()) {
+            epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &event);
+        } else {
+            epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &event);
+        }
+        readers[fd] = &waiter;
+    }
+}
+
+
+/* Process events */
+bool CM1106_Reactor::run_once(int timeout_ms) {
+
+    if (timers.empty()) {
+        return false;
+    }
+
+    // Do not wait beyond the first deadline
+    unsigned long now = cm1106_millis();
+    unsigned long first = timers.begin()->first;
+    if (first <= now) {
+        timeout_ms = 0;
+    } else if (timeout_ms < 0 || (unsigned long)timeout_ms > first - now) {
+        timeout_ms = first - now;
+    }
+
+    int nb = epoll_wait(epfd, events, CM1106_REACTOR_EVENTS, timeout_ms);
+
+    for (int i = 0; i < nb; i++) {
+        auto reader = readers.find(events[i].data.fd);
+        if (reader == readers.end() || reader->second == NULL) {
+            continue;
+        }
+        CM1106_Waiter *waiter = reader->second;
+        reader->second = NULL;
+        timers.erase(waiter->timer);
+        waiter->wake();
+    }
+
+    // Expired deadlines (waiters woken up may wait again)
+    now = cm1106_millis();
+    while (!timers.empty() && timers.begin()->first <= now) {
+        CM1106_Waiter *waiter = timers.begin()->second;
+        timers.erase(timers.begin());
+        if (waiter->fd >= 0) {
+            readers[waiter->fd] = NULL;
+        }
+        waiter->wake();
+    }
+
+    return !timers.empty();
+}
+
+
+/* Process events until nothing is waited */
+void CM1106_Reactor::run() {
+    while (run_once(-1));
+}
+
+
+void CM1106_Reactor::Sleep::await_suspend(std::coroutine_handle<> handle) {
+    this->handle = handle;
+    reactor.wait(*this, -1, cm1106_millis() + ms);
+}
+
+
+/* Initialize */
+CM1106_AsyncUART::CM1106_AsyncUART(CM1106_Reactor &reactor, CM1106_PosixSerial &serial) :
+    reactor(reactor), serial(serial), sensor(serial)
+{
+}
+
+
+/* Get blocking driver */
+CM1106_PosixUART &CM1106_AsyncUART::get_sensor() {
+    return sensor;
+}
+
+
+CM1106_AsyncUART::CO2 CM1106_AsyncUART::co2() {
+    return CO2(*this, CM1106_ID_GET_CO2);
+}
+
+
+CM1106_AsyncUART::ABC CM1106_AsyncUART::abc() {
+    return ABC(*this, CM1106_ID_GET_ABC);
+}
+
+
+/* Send request, resume at once if it can not be sent */
+bool CM1106_AsyncUART::Request::await_suspend(std::coroutine_handle<> handle) {
+    bool sent;
+
+    if (id == CM1106_ID_GET_ABC) {
+        sent = owner.sensor.begin_get_ABC();
+    } else {
+        sent = owner.sensor.begin_get_co2();
+    }
+
+    if (!sent) {
+        status = CM1106_POLL_ERROR;
+        return false;
+    }
+
+    // Same adaptive timeout as the driver, which fails the request in poll() once it is elapsed
+    status = CM1106_POLL_PENDING;
+    started = cm1106_millis();
+    deadline = started + owner.sensor.get_timeout(id);
+    this->handle = handle;
+    owner.reactor.wait(*this, owner.serial.get_fd(), deadline);
+
+    return true;
+}
+
+
+/* Bytes received or deadline expired: resume when response is complete */
+void CM1106_AsyncUART::Request::wake() {
+
+    status = owner.sensor.poll();
+    if (status == CM1106_POLL_PENDING) {
+        // Past the deadline, the driver ends the request itself: without response, it waits until the full timeout unless the sensor is lost
+        unsigned long now = cm1106_millis();
+        if ((long)(deadline - now) <= 0) {
+            unsigned long full = started + CM1106_DESCRIPTORS[id]->timeout_ms;
+            deadline = (long)(full - now) > 0 ? full : now + 1;
+        }
+        owner.reactor.wait(*this, owner.serial.get_fd(), deadline);
+        return;
+    }
+
+    handle.resume();
+}
+
+
+std::optional<int16_t> CM1106_AsyncUART::CO2::await_resume() {
+    if (status != CM1106_POLL_READY) {
+        return std::nullopt;
+    }
+
+    return owner.sensor.get_last_co2();
+}
+
+
+std::optional<CM1106_ABC> CM1106_AsyncUART::ABC::await_resume() {
+    CM1106_ABC abc;
+
+    if (status != CM1106_POLL_READY || !owner.sensor.get_last_ABC(&abc)) {
+        return std::nullopt;
+    }
+
+    return abc;
+}
+
+#endif
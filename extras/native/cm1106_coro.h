@@ -0,0 +1,159 @@
+/*
+    CM1106 Library for serial communication (UART)
+
+Copyright (c) 2021 Josep Comas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/    
+
+
+#if !defined(_CM1106_CORO) && defined(__linux__) && defined(__cpp_impl_coroutine)
+    #define _CM1106_CORO
+
+    #include <coroutine>
+    #include <map>
+    #include <optional>
+    #include <unordered_map>
+    #include <sys/epoll.h>
+
+    #include "cm1106_posix_serial.h"
+
+    #define CM1106_REACTOR_EVENTS   256   // Max events taken by each epoll_wait()
+
+
+    /* Coroutine started at once and destroyed when it ends (results are delivered by co_await) */
+    struct CM1106_Task
+    {
+        struct promise_type {
+            CM1106_Task get_return_object() { return CM1106_Task(); }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception() { std::terminate(); }
+        };
+    };
+
+
+    class CM1106_Reactor;
+
+    /* Something suspended in the reactor, woken up when its descriptor is readable or its deadline expires */
+    class CM1106_Waiter
+    {
+        public:
+            virtual ~CM1106_Waiter() {}
+
+        protected:
+            virtual void wake() = 0;                                            // Called by the reactor
+
+        private:
+            friend class CM1106_Reactor;
+            std::multimap<unsigned long, CM1106_Waiter*>::iterator timer;       // Deadline in reactor
+            int fd;                                                             // Descriptor waited (-1 if none)
+    };
+
+
+    /* Event loop resuming coroutines on received bytes and on deadlines, from one thread (Linux) */
+    class CM1106_Reactor
+    {
+        public:
+            CM1106_Reactor();                                                   // Initialize
+            ~CM1106_Reactor();
+            void wait(CM1106_Waiter &waiter, int fd, unsigned long deadline);   // Suspend waiter until fd is readable or deadline (ms)
+            bool run_once(int timeout_ms);                                      // Process events, false if nothing is waited
+            void run();                                                         // Process events until nothing is waited
+
+            /* Awaitable of sleep() */
+            class Sleep : public CM1106_Waiter
+            {
+                public:
+                    Sleep(CM1106_Reactor &reactor, uint32_t ms) : reactor(reactor), ms(ms) {}
+                    bool await_ready() { return ms == 0; }
+                    void await_suspend(std::coroutine_handle<> handle);
+                    void await_resume() {}
+
+                protected:
+                    void wake() override { handle.resume(); }
+
+                private:
+                    CM1106_Reactor &reactor;
+                    uint32_t ms;
+                    std::coroutine_handle<> handle;
+            };
+
+            Sleep sleep(uint32_t ms) { return Sleep(*this, ms); }               // co_await reactor.sleep(ms)
+
+        private:
+            int epfd;                                                           // epoll descriptor
+            epoll_event events[CM1106_REACTOR_EVENTS];                          // Events of last epoll_wait()
+            std::multimap<unsigned long, CM1106_Waiter*> timers;                // Waiters by deadline
+            std::unordered_map<int, CM1106_Waiter*> readers;                    // Waiters by descriptor (NULL if none)
+    };
+
+
+    /* Sensor on a POSIX serial port with awaitable requests:
+           std::optional<int16_t> co2 = co_await sensor.co2();
+           std::optional<CM1106_ABC> abc = co_await sensor.abc();
+       Blocking requests remain available with get_sensor(). */
+    class CM1106_AsyncUART
+    {
+        public:
+            CM1106_AsyncUART(CM1106_Reactor &reactor, CM1106_PosixSerial &serial);  // Initialize
+            CM1106_PosixUART &get_sensor();                                     // Get blocking driver
+
+            /* Awaitable of a request */
+            class Request : public CM1106_Waiter
+            {
+                public:
+                    Request(CM1106_AsyncUART &owner, uint8_t id) : owner(owner), id(id) {}
+                    bool await_ready() { return false; }
+                    bool await_suspend(std::coroutine_handle<> handle);         // Send request, false (resume at once) if it can not be sent
+
+                protected:
+                    void wake() override;
+                    CM1106_AsyncUART &owner;
+                    uint8_t id;                                                 // Command (CM1106_ID_xxx)
+                    uint8_t status;                                             // Result (CM1106_POLL_xxx)
+
+                private:
+                    unsigned long started;                                      // Time (ms) of request
+                    unsigned long deadline;                                     // Time (ms) to check request again
+                    std::coroutine_handle<> handle;
+            };
+
+            struct CO2 : Request {
+                using Request::Request;
+                std::optional<int16_t> await_resume();                          // CO2 value in ppm (empty on error)
+            };
+
+            struct ABC : Request {
+                using Request::Request;
+                std::optional<CM1106_ABC> await_resume();                       // ABC parameters (empty on error)
+            };
+
+            CO2 co2();                                                          // co_await sensor.co2()
+            ABC abc();                                                          // co_await sensor.abc()
+
+        private:
+            CM1106_Reactor &reactor;
+            CM1106_PosixSerial &serial;
+            CM1106_PosixUART sensor;
+    };
+
+#endif
@@ -0,0 +1,553 @@
+/*
+    CM1106 Library for serial communication (UART)
+
+Copyright (c) 2021 Josep Comas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include "cm1106_emulator.h"
+#include "cm1106_uart.h"
+
+
+/* Initialize */
+CM1106_Emulator::CM1106_Emulator(uint8_t model)
+{
+    this->model = model;
+    co2 = 415;
+    for (uint8_t i = 0; i < 5; i++) {
+        sn[i] = 1000 * (i + 1) + i;
+    }
+    if (model == CM1106_EMU_MODEL_SL_NS) {
+        set_software_version("1.06 SL-NS");
+    } else {
+        set_software_version("CM V1.06.1");
+    }
+    abc_open_close = CM1106_ABC_OPEN;
+    abc_cycle = 7;
+    abc_base = 400;
+    abc_started = false;
+    abc_start = 0;
+    abc_min = INT16_MAX;
+    abc_offset = 0;
+    abc_corrections = 0;
+    drift = 0;
+    drift_start = 0;
+    period = 120;
+    smoothed = 1;
+    working_status = CM1106_CONTINUOUS_MEASUREMENT;
+    nak_unsupported = false;
+
+    enabled = true;
+    measure_us = CM1106_EMU_MEASURE_TIME;
+    enable_time = 0;
+    measured = false;
+    measured_co2 = 0;
+    measurements = 0;
+
+    latency_us = 2000;
+    byte_us = CM1106_EMU_BYTE_TIME;
+    jitter_us = 0;
+
+    rnd_state = 0x1106CAFE;
+    silent = false;
+    nak_rate = 0;
+    corrupt_rate = 0;
+    split_rate = 0;
+    split_gap_us = 20000;
+    truncate_rate = 0;
+    garbage_rate = 0;
+    noise_nb = 0;
+
+    requests = 0;
+    config_writes = 0;
+    responses = 0;
+
+    request_nb = 0;
+    queue_head = 0;
+    queue_count = 0;
+}
+
+
+/* Bytes of responses already transferred */
+int CM1106_Emulator::available() {
+    unsigned long now = cm1106_micros();
+    int nb = 0;
+
+    while (nb < queue_count && (long)(now - queue_time[(queue_head + nb) % CM1106_EMU_LEN_QUEUE]) >= 0) {
+        nb++;
+    }
+
+    return nb;
+}
+
+
+/* Read a byte of response */
+int CM1106_Emulator::read() {
+
+    if (available() == 0) {
+        return -1;
+    }
+
+    uint8_t data = queue_data[queue_head];
+    queue_head = (queue_head + 1) % CM1106_EMU_LEN_QUEUE;
+    queue_count--;
+
+    return data;
+}
+
+
+/* Next byte of response without removing it */
+int CM1106_Emulator::peek() {
+
+    if (available() == 0) {
+        return -1;
+    }
+
+    return queue_data[queue_head];
+}
+
+
+/* Receive a byte of request */
+size_t CM1106_Emulator::write(uint8_t data) {
+
+    // Wait packet identifier
+    if (request_nb == 0 && data != CM1106_MSG_IP) {
+        return 1;
+    }
+
+    request[request_nb++] = data;
+
+    // Check length
+    if (request_nb == 2 && (data == 0 || data > CM1106_EMU_LEN_REQUEST - 3)) {
+        request_nb = 0;
+        return 1;
+    }
+
+    if (request_nb > 2 && request_nb == request[1] + 3) {
+        process_request();
+        request_nb = 0;
+    }
+
+    return 1;
+}
+
+
+void CM1106_Emulator::flush() {
+}
+
+
+void CM1106_Emulator::set_co2(int16_t co2) {
+    this->co2 = co2;
+}
+
+
+void CM1106_Emulator::set_serial_number(const uint16_t sn[5]) {
+    memcpy(this->sn, sn, sizeof(this->sn));
+}
+
+
+void CM1106_Emulator::set_software_version(const char softver[]) {
+    size_t len = strlen(softver);
+    if (len > sizeof(this->softver) - 1) {
+        len = sizeof(this->softver) - 1;
+    }
+    memset(this->softver, 0, sizeof(this->softver));
+    memcpy(this->softver, softver, len);
+}
+
+
+void CM1106_Emulator::set_nak_unsupported(bool nak) {
+    nak_unsupported = nak;
+}
+
+
+void CM1106_Emulator::set_drift(int16_t ppm_per_day) {
+    drift = ppm_per_day;
+    drift_start = cm1106_millis();
+}
+
+
+uint32_t CM1106_Emulator::get_abc_corrections() {
+    return abc_corrections;
+}
+
+
+int16_t CM1106_Emulator::get_abc_offset() {
+    return abc_offset;
+}
+
+
+/* Enable (power) the sensor: starts a measurement in single measurement mode */
+void CM1106_Emulator::set_enabled(bool enable) {
+    if (enable && !enabled) {
+        enable_time = cm1106_micros();
+        measured = false;
+    }
+    enabled = enable;
+}
+
+
+void CM1106_Emulator::set_measure_time(uint32_t measure_us) {
+    this->measure_us = measure_us;
+}
+
+
+uint32_t CM1106_Emulator::get_measurements() {
+    return measurements;
+}
+
+
+void CM1106_Emulator::set_latency(uint32_t latency_us) {
+    this->latency_us = latency_us;
+}
+
+
+void CM1106_Emulator::set_byte_time(uint32_t byte_us) {
+    this->byte_us = byte_us;
+}
+
+
+void CM1106_Emulator::set_jitter(uint32_t jitter_us) {
+    this->jitter_us = jitter_us;
+}
+
+
+void CM1106_Emulator::set_seed(uint32_t seed) {
+    rnd_state = (seed != 0) ? seed : 1;
+}
+
+
+void CM1106_Emulator::set_silent(bool silent) {
+    this->silent = silent;
+}
+
+
+void CM1106_Emulator::set_nak_rate(uint8_t percent) {
+    nak_rate = percent;
+}
+
+
+void CM1106_Emulator::set_corrupt_rate(uint8_t percent) {
+    corrupt_rate = percent;
+}
+
+
+void CM1106_Emulator::set_split_rate(uint8_t percent) {
+    split_rate = percent;
+}
+
+
+void CM1106_Emulator::set_split_gap(uint32_t gap_us) {
+    split_gap_us = gap_us;
+}
+
+
+void CM1106_Emulator::set_truncate_rate(uint8_t percent) {
+    truncate_rate = percent;
+}
+
+
+void CM1106_Emulator::set_garbage_rate(uint8_t percent) {
+    garbage_rate = percent;
+}
+
+
+/* Send given bytes before next response (once) */
+void CM1106_Emulator::inject_noise(const uint8_t data[], uint8_t nb) {
+    noise_nb = nb < CM1106_EMU_LEN_NOISE ? nb : CM1106_EMU_LEN_NOISE;
+    memcpy(noise, data, noise_nb);
+}
+
+
+uint32_t CM1106_Emulator::get_requests() {
+    return requests;
+}
+
+
+uint32_t CM1106_Emulator::get_responses() {
+    return responses;
+}
+
+
+uint32_t CM1106_Emulator::get_config_writes() {
+    return config_writes;
+}
+
+
+/* Answer a complete request */
+void CM1106_Emulator::process_request() {
+    uint8_t sum = 0;
+    for (uint8_t i = 0; i < request_nb; i++) {
+        sum += request[i];
+    }
+
+    requests++;
+
+    if (silent || !enabled) {
+        return;
+    }
+
+    if (sum != 0) {
+        answer_nak(0x02);
+        return;
+    }
+
+    uint8_t cmd = request[2];
+    uint8_t nb_data = request[1] - 1;
+    const uint8_t *data = &request[3];
+    bool low_power = (model == CM1106_EMU_MODEL_SL_NS);
+    uint8_t out[11];
+
+    if (cmd == CM1106_CMD_GET_CO2 && nb_data == 0) {
+        int16_t value = reported_co2();
+        out[0] = (value >> 8) & 0xFF;
+        out[1] = value & 0xFF;
+        out[2] = 0x00;
+        out[3] = 0x00;
+        answer(cmd, out, 4);
+
+    } else if (cmd == CM1106_CMD_START_CALIBRATION && nb_data == 2) {
+        co2 = (data[0] << 8) | data[1];
+        answer(cmd, NULL, 0);
+
+    } else if (cmd == CM1106_CMD_GET_ABC && nb_data == 0) {
+        out[0] = 0x64;
+        out[1] = abc_open_close;
+        out[2] = abc_cycle;
+        out[3] = (abc_base >> 8) & 0xFF;
+        out[4] = abc_base & 0xFF;
+        out[5] = 0x64;
+        answer(cmd, out, 6);
+
+    } else if (cmd == CM1106_CMD_SET_ABC && nb_data == 6) {
+        abc_open_close = data[1];
+        abc_cycle = data[2];
+        abc_base = (data[3] << 8) | data[4];
+        abc_started = false;
+        config_writes++;
+        answer(cmd, NULL, 0);
+
+    } else if (cmd == CM1106_CMD_GET_SOFTWARE_VERSION && nb_data == 0) {
+        memcpy(out, softver, 10);
+        out[10] = 0x00;
+        answer(cmd, out, 11);
+
+    } else if (cmd == CM1106_CMD_GET_SERIAL_NUMBER && nb_data == 0) {
+        uint8_t sn_data[10];
+        for (uint8_t i = 0; i < 5; i++) {
+            sn_data[2 * i] = (sn[i] >> 8) & 0xFF;
+            sn_data[2 * i + 1] = sn[i] & 0xFF;
+        }
+        answer(cmd, sn_data, 10);
+
+    } else if (low_power && cmd == CM1106_CMD_STORE_ABC_DATA && nb_data == 0) {
+        answer(cmd, NULL, 0);
+
+    } else if (low_power && cmd == CM1106_CMD_MEASUREMENT_PERIOD && nb_data == 0) {
+        out[0] = (period >> 8) & 0xFF;
+        out[1] = period & 0xFF;
+        out[2] = smoothed;
+        answer(cmd, out, 3);
+
+    } else if (low_power && cmd == CM1106_CMD_MEASUREMENT_PERIOD && nb_data == 3) {
+        period = (data[0] << 8) | data[1];
+        smoothed = data[2];
+        config_writes++;
+        answer(cmd, NULL, 0);
+
+    } else if (low_power && cmd == CM1106_CMD_WORKING_STATUS && nb_data == 0) {
+        out[0] = working_status;
+        answer(cmd, out, 1);
+
+    } else if (low_power && cmd == CM1106_CMD_WORKING_STATUS && nb_data == 1) {
+        working_status = data[0];
+        config_writes++;
+        answer(cmd, NULL, 0);
+
+    } else if (nak_unsupported) {
+        answer_nak(0x02);
+    }
+}
+
+
+/* CO2 value according to working status: last measurement in single measurement mode */
+int16_t CM1106_Emulator::reported_co2() {
+
+    if (model != CM1106_EMU_MODEL_SL_NS || working_status != CM1106_SINGLE_MEASUREMENT) {
+        return measure();
+    }
+
+    if (!measured && cm1106_micros() - enable_time >= measure_us) {
+        measured = true;
+        measured_co2 = measure();
+        measurements++;
+    }
+
+    return measured_co2;
+}
+
+
+/* Measure CO2 value applying drift and ABC */
+int16_t CM1106_Emulator::measure() {
+    unsigned long now = cm1106_millis();
+    int16_t raw = co2;
+
+    if (drift != 0) {
+        raw += (int64_t)drift * (int64_t)(now - drift_start) / (int64_t)CM1106_EMU_DAY;
+    }
+
+    if (abc_open_close != CM1106_ABC_OPEN || abc_cycle == 0) {
+        abc_started = false;
+        return raw - abc_offset;
+    }
+
+    if (!abc_started) {
+        abc_started = true;
+        abc_start = now;
+        abc_min = INT16_MAX;
+    }
+
+    // End of cycle: lowest measurement becomes the baseline
+    unsigned long cycle_ms = abc_cycle * CM1106_EMU_DAY;
+    if (now - abc_start >= cycle_ms) {
+        if (abc_min != INT16_MAX) {
+            abc_offset = abc_min - abc_base;
+            abc_corrections++;
+        }
+        abc_start += (now - abc_start) / cycle_ms * cycle_ms;
+        abc_min = INT16_MAX;
+    }
+
+    if (raw < abc_min) {
+        abc_min = raw;
+    }
+
+    return raw - abc_offset;
+}
+
+
+/* Send a valid response */
+void CM1106_Emulator::answer(uint8_t cmd, const uint8_t data[], uint8_t size) {
+
+    if (chance(nak_rate)) {
+        answer_nak(0x02);
+        return;
+    }
+
+    uint8_t frame[CM1106_LEN_BUF_MSG];
+    frame[0] = CM1106_MSG_ACK;
+    frame[1] = size + 1;
+    frame[2] = cmd;
+    if (size > 0) {
+        memcpy(&frame[3], data, size);
+    }
+    send_frame(frame, size + 4);
+}
+
+
+/* Send a NAK response */
+void CM1106_Emulator::answer_nak(uint8_t error) {
+    uint8_t frame[4] = {CM1106_MSG_NAK, 0x01, error, 0x00};
+    send_frame(frame, 4);
+}
+
+
+/* Queue a response applying timing and faults */
+void CM1106_Emulator::send_frame(uint8_t *frame, uint8_t size) {
+
+    // Checksum
+    uint8_t sum = 0;
+    for (uint8_t i = 0; i < size - 1; i++) {
+        sum += frame[i];
+    }
+    frame[size - 1] = -sum;
+
+    if (chance(corrupt_rate)) {
+        frame[size - 1] ^= 0x5A;
+    }
+
+    uint8_t nb = size;
+    if (chance(truncate_rate)) {
+        nb = 1 + random_value() % (size - 1);
+    }
+
+    uint8_t split_at = CM1106_EMU_LEN_REQUEST;
+    if (chance(split_rate)) {
+        split_at = 1 + random_value() % (size - 1);
+    }
+
+    // Bytes are transmitted after previous queued ones
+    unsigned long t = cm1106_micros() + latency_us;
+    if (queue_count > 0) {
+        unsigned long last = queue_time[(queue_head + queue_count - 1) % CM1106_EMU_LEN_QUEUE];
+        if ((long)(last - t) > 0) {
+            t = last;
+        }
+    }
+
+    bool garbage = chance(garbage_rate);
+    uint8_t prefix = noise_nb + (garbage ? 1 : 0);
+
+    // Injected noise, random byte, then response
+    for (uint8_t i = 0; i < nb + prefix && queue_count < CM1106_EMU_LEN_QUEUE; i++) {
+        uint8_t data;
+        if (i < noise_nb) {
+            data = noise[i];
+        } else if (i < prefix) {
+            data = random_value() & 0xFF;
+        } else {
+            uint8_t j = i - prefix;
+            data = frame[j];
+            if (j == split_at) {
+                t += split_gap_us;
+            }
+        }
+
+        t += byte_us;
+        if (jitter_us > 0) {
+            t += random_value() % (jitter_us + 1);
+        }
+
+        uint8_t k = (queue_head + queue_count) % CM1106_EMU_LEN_QUEUE;
+        queue_data[k] = data;
+        queue_time[k] = t;
+        queue_count++;
+    }
+    noise_nb = 0;
+
+    responses++;
+}
+
+
+/* True with given probability */
+bool CM1106_Emulator::chance(uint8_t percent) {
+    return percent > 0 && (random_value() % 100) < percent;
+}
+
+
+/* Pseudo random number (xorshift32) */
+uint32_t CM1106_Emulator::random_value() {
+    rnd_state ^= rnd_state << 13;
+    rnd_state ^= rnd_state >> 17;
+    rnd_state ^= rnd_state << 5;
+    return rnd_state;
+}
@@ -0,0 +1,163 @@
+/*
+    CM1106 Library for serial communication (UART)
+
+Copyright (c) 2021 Josep Comas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/    
+
+
+#ifndef _CM1106_EMULATOR
+    #define _CM1106_EMULATOR
+
+    #include "Arduino.h"
+
+    #define CM1106_EMU_BYTE_TIME      1042   // Time to transfer one byte at 9600 8N1 (us)
+    #define CM1106_EMU_LEN_QUEUE       128   // Max bytes of responses waiting to be read
+    #define CM1106_EMU_LEN_REQUEST      20   // Max length of a request
+    #define CM1106_EMU_LEN_NOISE         8   // Max bytes of noise injected before a response
+    #define CM1106_EMU_MEASURE_TIME 1000000   // Time from enable to first measurement in single measurement mode (us)
+    #define CM1106_EMU_DAY         86400000UL   // Duration of a day (ms) for drift and ABC cycles
+
+    #define CM1106_EMU_MODEL_CM1106      0   // Emulate CM1106
+    #define CM1106_EMU_MODEL_SL_NS       1   // Emulate low power version CM1106SL-NS
+
+
+    /* Emulator of a CM1106 sensor connected through a Stream.
+       Requests written to the stream are answered with responses whose bytes
+       become available according to the emulated response latency, byte time
+       and jitter. Faults can be injected with a given probability (percent). */
+    class CM1106_Emulator : public Stream
+    {
+        public:
+            CM1106_Emulator(uint8_t model = CM1106_EMU_MODEL_CM1106);          // Initialize
+
+            /* Stream */
+            int available() override;
+            int read() override;
+            int peek() override;
+            size_t write(uint8_t data) override;
+            using Print::write;
+            void flush() override;
+
+            /* Emulated sensor */
+            void set_co2(int16_t co2);                                          // Set CO2 value in ppm
+            void set_serial_number(const uint16_t sn[5]);                       // Set serial number
+            void set_software_version(const char softver[]);                    // Set software version
+            void set_nak_unsupported(bool nak);                                 // Answer NAK to unsupported commands (default no answer)
+            void set_drift(int16_t ppm_per_day);                                // Add an error growing each day to measurements (from now)
+
+            /* Automatic baseline correction (ABC): when open, at the end of each cycle the lowest
+               measurement of the cycle is corrected to the baseline */
+            uint32_t get_abc_corrections();                                     // Get number of cycles ended with a correction
+            int16_t get_abc_offset();                                           // Get current correction (ppm)
+
+            /* Single measurement mode (CM1106SL-NS): while enabled, the sensor measures once after
+               measure time and keeps reporting that value; a disabled sensor does not answer */
+            void set_enabled(bool enable);                                      // Drive enable (power) of the sensor
+            void set_measure_time(uint32_t measure_us);                         // Set time from enable to measurement
+            uint32_t get_measurements();                                        // Get number of measurements done in single measurement mode
+
+            /* Timing */
+            void set_latency(uint32_t latency_us);                              // Set delay from request to first byte of response
+            void set_byte_time(uint32_t byte_us);                               // Set transfer time of each byte (0 = instantaneous)
+            void set_jitter(uint32_t jitter_us);                                // Set max random delay added to each byte
+
+            /* Faults */
+            void set_seed(uint32_t seed);                                       // Set seed of pseudo random generator
+            void set_silent(bool silent);                                       // Never answer
+            void set_nak_rate(uint8_t percent);                                 // Answer NAK instead of valid response
+            void set_corrupt_rate(uint8_t percent);                             // Answer with wrong checksum
+            void set_split_rate(uint8_t percent);                               // Pause in the middle of response
+            void set_split_gap(uint32_t gap_us);                                // Duration of pause of split responses
+            void set_truncate_rate(uint8_t percent);                            // Answer only a part of response
+            void set_garbage_rate(uint8_t percent);                             // Send a random byte before response
+            void inject_noise(const uint8_t data[], uint8_t nb);                // Send given bytes before next response (once)
+
+            /* Statistics */
+            uint32_t get_requests();                                            // Get number of requests received
+            uint32_t get_responses();                                           // Get number of responses sent
+            uint32_t get_config_writes();                                       // Get number of settings written (ABC, measurement period, working status)
+
+        private:
+            uint8_t model;                                                      // Emulated model
+            int16_t co2;                                                        // CO2 value
+            uint16_t sn[5];                                                     // Serial number
+            char softver[11];                                                   // Software version
+            uint8_t abc_open_close;                                             // ABC parameters
+            uint8_t abc_cycle;
+            int16_t abc_base;
+            bool abc_started;                                                   // Current ABC cycle started
+            unsigned long abc_start;                                            // Time (ms) when ABC cycle started
+            int16_t abc_min;                                                    // Lowest measurement (without correction) of ABC cycle
+            int16_t abc_offset;                                                 // Correction of ABC
+            uint32_t abc_corrections;
+            int16_t drift;                                                      // Error added each day (ppm)
+            unsigned long drift_start;                                          // Time (ms) when drift started
+            int16_t period;                                                     // Measurement period (CM1106SL-NS)
+            uint8_t smoothed;                                                   // Number of smoothed data (CM1106SL-NS)
+            uint8_t working_status;                                             // Working status (CM1106SL-NS)
+            bool nak_unsupported;
+
+            bool enabled;                                                       // Sensor powered
+            uint32_t measure_us;                                                // Time from enable to measurement (single measurement mode)
+            unsigned long enable_time;                                          // Time (us) when sensor was enabled
+            bool measured;                                                      // Measurement done since enable
+            int16_t measured_co2;                                               // CO2 value of last measurement (single measurement mode)
+            uint32_t measurements;
+
+            uint32_t latency_us;
+            uint32_t byte_us;
+            uint32_t jitter_us;
+
+            uint32_t rnd_state;
+            bool silent;
+            uint8_t nak_rate;
+            uint8_t corrupt_rate;
+            uint8_t split_rate;
+            uint32_t split_gap_us;
+            uint8_t truncate_rate;
+            uint8_t garbage_rate;
+            uint8_t noise[CM1106_EMU_LEN_NOISE];                                // Bytes injected before next response
+            uint8_t noise_nb;
+
+            uint32_t requests;
+            uint32_t responses;
+            uint32_t config_writes;
+
+            uint8_t request[CM1106_EMU_LEN_REQUEST];                            // Request being received
+            uint8_t request_nb;
+
+            uint8_t queue_data[CM1106_EMU_LEN_QUEUE];                           // Bytes of responses
+            unsigned long queue_time[CM1106_EMU_LEN_QUEUE];                     // Time (us) when each byte is available
+            uint8_t queue_head;
+            uint8_t queue_count;
+
+            void process_request();                                             // Answer a complete request
+            int16_t reported_co2();                                             // CO2 value according to working status
+            int16_t measure();                                                  // Measure CO2 value applying drift and ABC
+            void answer(uint8_t cmd, const uint8_t data[], uint8_t size);       // Send a valid response
+            void answer_nak(uint8_t error);                                     // Send a NAK response
+            void send_frame(uint8_t *frame, uint8_t size);                      // Queue a response applying timing and faults
+            bool chance(uint8_t percent);                                       // True with given probability
+            uint32_t random_value();                                            // Pseudo random number (xorshift32)
+    };
+
+#endif
@@ -0,0 +1,315 @@
+/*
+    CM1106 Library for serial communication (UART)
+
+Copyright (c) 2021 Josep Comas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include "cm1106_epoll.h"
+
+#ifdef __linux__
+
+#include "cm1106_commands.h"
+#include <unistd.h>
+
+
+/* Initialize */
+CM1106_Epoll::CM1106_Epoll()
+{
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    nb_pending = 0;
+    sweep_start = 0;
+    next_deadline = 0;
+}
+
+
+CM1106_Epoll::~CM1106_Epoll() {
+    if (epfd >= 0) {
+        close(epfd);
+    }
+}
+
+
+/* Open a sensor */
+int CM1106_Epoll::add(const char *device) {
+    std::unique_ptr<Port> port(new Port());
+
+    if (!port->serial.begin(device)) {
+        CM1106_LOG("DEBUG: Error opening %s!\n", device);
+        return -1;
+    }
+    port->device = device;
+
+    return add_port(std::move(port));
+}
+
+
+/* Add a sensor on an open descriptor */
+int CM1106_Epoll::add(int fd, bool configure) {
+    std::unique_ptr<Port> port(new Port());
+
+    if (!port->serial.begin(fd, configure)) {
+        CM1106_LOG("DEBUG: Error configuring descriptor %d!\n", fd);
+        return -1;
+    }
+
+    return add_port(std::move(port));
+}
+
+
+/* Register port in epoll */
+int CM1106_Epoll::add_port(std::unique_ptr<Port> port) {
+
+    if (epfd < 0 || nb_pending > 0) {
+        return -1;
+    }
+
+    port->registered = false;
+    if (!register_port(*port)) {
+        return -1;
+    }
+
+    port->reading.timestamp = 0;
+    port->reading.co2 = 0;
+    port->reading.status = CM1106_READING_ERROR;
+    port->pending = false;
+    port->started = 0;
+    port->deadline = 0;
+    ports.push_back(std::move(port));
+
+    return ports.size() - 1;
+}
+
+
+/* Add descriptor of port to epoll */
+bool CM1106_Epoll::register_port(Port &port) {
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = &port;
+
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, port.serial.get_fd(), &event) < 0) {
+        CM1106_LOG("DEBUG: Error adding descriptor to epoll!\n");
+        return false;
+    }
+    port.registered = true;
+
+    return true;
+}
+
+
+/* Get number of sensors */
+size_t CM1106_Epoll::get_count() {
+    return ports.size();
+}
+
+
+/* Get driver of a sensor */
+CM1106_PosixUART *CM1106_Epoll::get_sensor(size_t index) {
+    return index < ports.size() ? &ports[index]->sensor : NULL;
+}
+
+
+/* Send CO2 request to all sensors */
+bool CM1106_Epoll::begin_sweep() {
+
+    if (nb_pending > 0) {
+        CM1106_LOG("DEBUG: Sweep already in progress!\n");
+        return false;
+    }
+
+    sweep_start = cm1106_millis();
+    next_deadline = sweep_start + CM1106_TIMEOUT_MS;
+    for (auto &port : ports) {
+        port->reading.co2 = 0;
+        port->reading.status = CM1106_READING_ERROR;
+        port->pending = false;
+
+        // Lost sensors are skipped until their probe is due, their request is the probe
+        if (port->health.is_due() && reopen(*port)) {
+            port->pending = port->sensor.begin_get_co2();
+            if (!port->pending) {
+                port->health.report(false);
+            }
+        }
+
+        if (port->pending) {
+            port->started = cm1106_millis();
+            port->deadline = port->started + port->sensor.get_timeout(CM1106_ID_GET_CO2);
+            if ((long)(port->deadline - next_deadline) < 0) {
+                next_deadline = port->deadline;
+            }
+            nb_pending++;
+        } else {
+            port->reading.timestamp = sweep_start;
+        }
+    }
+
+    return true;
+}
+
+
+/* Wait and process received bytes */
+bool CM1106_Epoll::poll(int timeout_ms) {
+
+    if (nb_pending == 0) {
+        return true;
+    }
+
+    // Do not wait beyond the first deadline of the requests
+    long remaining = (long)(next_deadline - cm1106_millis());
+    if (remaining <= 0) {
+        timeout_ms = 0;
+    } else if (timeout_ms < 0 || timeout_ms > remaining) {
+        timeout_ms = remaining;
+    }
+
+    int nb = epoll_wait(epfd, events, CM1106_EPOLL_EVENTS, timeout_ms);
+
+    for (int i = 0; i < nb; i++) {
+        Port &port = *static_cast<Port*>(events[i].data.ptr);
+
+        if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+            CM1106_LOG("DEBUG: Port %d lost!\n", port.serial.get_fd());
+            epoll_ctl(epfd, EPOLL_CTL_DEL, port.serial.get_fd(), NULL);
+            port.registered = false;
+            if (port.pending) {
+                complete(port, CM1106_POLL_ERROR);
+            }
+            continue;
+        }
+
+        if (port.pending) {
+            uint8_t status = port.sensor.poll();
+            if (status != CM1106_POLL_PENDING) {
+                complete(port, status);
+            }
+        } else {
+            // Unexpected bytes, drop them to not be woken up again
+            while (port.serial.read() >= 0);
+        }
+    }
+
+    // Requests without response: only scanned once the first deadline is passed
+    unsigned long now = cm1106_millis();
+    if (nb_pending > 0 && (long)(now - next_deadline) >= 0) {
+        next_deadline = now + CM1106_TIMEOUT_MS;
+        for (auto &port : ports) {
+            if (!port->pending) {
+                continue;
+            }
+            if ((long)(now - port->deadline) >= 0) {
+                // Without response, the driver waits until the full timeout unless the sensor is lost
+                uint8_t status = port->sensor.poll();
+                if (status != CM1106_POLL_PENDING) {
+                    complete(*port, status);
+                    continue;
+                }
+                unsigned long full = port->started + CM1106_TIMEOUT_MS;
+                port->deadline = (long)(full - now) > 0 ? full : now + 1;
+            }
+            if ((long)(port->deadline - next_deadline) < 0) {
+                next_deadline = port->deadline;
+            }
+        }
+    }
+
+    return nb_pending == 0;
+}
+
+
+/* Open and watch again a closed port */
+bool CM1106_Epoll::reopen(Port &port) {
+
+    if (!port.registered) {
+        // A device is opened again (adapter plugged back), a descriptor is only watched again
+        if ((!port.device.empty() && !port.serial.begin(port.device.c_str())) || !register_port(port)) {
+            port.health.report(false);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+/* Store result of a sensor */
+void CM1106_Epoll::complete(Port &port, uint8_t status) {
+
+    if (status == CM1106_POLL_READY) {
+        port.reading.co2 = port.sensor.get_last_co2();
+        port.reading.status = CM1106_READING_OK;
+    }
+    port.health.report(status == CM1106_POLL_READY);
+    port.reading.timestamp = cm1106_millis();
+    port.pending = false;
+    nb_pending--;
+}
+
+
+/* Read all sensors waiting responses */
+size_t CM1106_Epoll::sweep(CM1106_reading readings[]) {
+    size_t valid = 0;
+
+    if (!begin_sweep()) {
+        return 0;
+    }
+
+    while (!poll(-1));
+
+    for (size_t i = 0; i < ports.size(); i++) {
+        if (readings != NULL) {
+            readings[i] = ports[i]->reading;
+        }
+        if (ports[i]->reading.status == CM1106_READING_OK) {
+            valid++;
+        }
+    }
+
+    return valid;
+}
+
+
+/* Get reading of a sensor in last sweep */
+bool CM1106_Epoll::get_reading(size_t index, CM1106_reading *reading) {
+
+    if (index >= ports.size() || reading == NULL) {
+        return false;
+    }
+
+    *reading = ports[index]->reading;
+
+    return reading->status == CM1106_READING_OK;
+}
+
+
+/* Check if a sensor is lost */
+bool CM1106_Epoll::is_lost(size_t index) {
+    return index < ports.size() && ports[index]->health.get_state() == CM1106_HEALTH_LOST;
+}
+
+
+/* Get health of a sensor */
+CM1106_Health *CM1106_Epoll::get_health(size_t index) {
+    return index < ports.size() ? &ports[index]->health : NULL;
+}
+
+#endif
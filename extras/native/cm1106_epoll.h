@@ -0,0 +1,91 @@
+/*
+    CM1106 Library for serial communication (UART)
+
+Copyright (c) 2021 Josep Comas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/    
+
+
+#if !defined(_CM1106_EPOLL) && defined(__linux__)
+    #define _CM1106_EPOLL
+
+    #include <memory>
+    #include <string>
+    #include <vector>
+    #include <sys/epoll.h>
+
+    #include "cm1106_posix_serial.h"
+    #include "cm1106_health.h"
+
+    #define CM1106_EPOLL_EVENTS       256   // Max events taken by each epoll_wait()
+
+
+    /* Read many sensors on POSIX serial ports from one thread (Linux).
+       CO2 requests are sent to all sensors and each port is only read when epoll
+       reports received bytes, so its cost grows with the traffic, not the number of ports.
+       Each request waits the adaptive timeout of its driver, then until the full timeout if the
+       sensor is not lost. Each sensor has a CM1106_Health: a lost one is skipped by sweeps until its
+       probe is due, then its request of the sweep is the probe (port reopened if added by device). */
+    class CM1106_Epoll
+    {
+        public:
+            CM1106_Epoll();                                                     // Initialize
+            ~CM1106_Epoll();
+            int add(const char *device);                                        // Open a sensor, return its index (-1 on error)
+            int add(int fd, bool configure);                                    // Add a sensor on an open descriptor
+            size_t get_count();                                                 // Get number of sensors
+            CM1106_PosixUART *get_sensor(size_t index);                         // Get driver of a sensor
+            bool begin_sweep();                                                 // Send CO2 request to all sensors
+            bool poll(int timeout_ms);                                          // Wait and process received bytes, true when sweep is complete
+            size_t sweep(CM1106_reading readings[]);                            // Read all sensors waiting responses, return number of valid readings
+            bool get_reading(size_t index, CM1106_reading *reading);            // Get reading of a sensor in last sweep
+            bool is_lost(size_t index);                                         // Check if a sensor is lost (skipped until its next probe)
+            CM1106_Health *get_health(size_t index);                            // Get health of a sensor
+
+        private:
+            struct Port {
+                CM1106_PosixSerial serial;                                      // Serial port
+                CM1106_PosixUART sensor;                                        // Driver on serial port
+                CM1106_reading reading;                                         // Reading of last sweep
+                std::string device;                                             // Path of device (empty if added by descriptor)
+                bool registered;                                                // Descriptor is in epoll
+                bool pending;                                                   // Sensor has not answered yet
+                unsigned long started;                                          // Time (ms) of pending request
+                unsigned long deadline;                                         // Time (ms) to check pending request again
+                CM1106_Health health;                                           // Health of sensor, lost if port closed or not answering
+
+                Port() : sensor(serial), health(sensor) {}
+            };
+
+            std::vector<std::unique_ptr<Port>> ports;                           // Sensors
+            epoll_event events[CM1106_EPOLL_EVENTS];                            // Events of last epoll_wait()
+            int epfd;                                                           // epoll descriptor
+            size_t nb_pending;                                                  // Sensors not answered yet
+            unsigned long sweep_start;                                          // Time of last begin_sweep()
+            unsigned long next_deadline;                                        // First deadline of pending requests
+
+            int add_port(std::unique_ptr<Port> port);                           // Register port in epoll
+            bool register_port(Port &port);                                     // Add descriptor of port to epoll
+            bool reopen(Port &port);                                            // Open and watch again a closed port
+            void complete(Port &port, uint8_t status);                          // Store result of a sensor
+    };
+
+#endif
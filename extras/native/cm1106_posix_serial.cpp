@@ -0,0 +1,242 @@
+/*
+    CM1106 Library for serial communication (UART)
+
+Copyright (c) 2021 Josep Comas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include "cm1106_posix_serial.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+#include <termios.h>
+#include <unistd.h>
+
+
+/* Initialize */
+CM1106_PosixSerial::CM1106_PosixSerial()
+{
+    fd = -1;
+    own_fd = false;
+    drain = false;
+    buf_head = 0;
+    buf_count = 0;
+}
+
+
+CM1106_PosixSerial::~CM1106_PosixSerial() {
+    end();
+}
+
+
+/* Open and configure serial port */
+bool CM1106_PosixSerial::begin(const char *device, unsigned long baudrate) {
+
+    end();
+
+    fd = open(device, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    own_fd = true;
+
+    if (!configure(baudrate)) {
+        end();
+        return false;
+    }
+
+    return true;
+}
+
+
+/* Use an open descriptor */
+bool CM1106_PosixSerial::begin(int fd, bool configure) {
+
+    end();
+
+    this->fd = fd;
+    own_fd = false;
+
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        return false;
+    }
+
+    return !configure || this->configure(CM1106_BAUDRATE);
+}
+
+
+/* Close serial port */
+void CM1106_PosixSerial::end() {
+    if (fd >= 0 && own_fd) {
+        close(fd);
+    }
+    fd = -1;
+    buf_head = 0;
+    buf_count = 0;
+}
+
+
+/* Get file descriptor */
+int CM1106_PosixSerial::get_fd() {
+    return fd;
+}
+
+
+/* Wait end of transmission in flush() */
+void CM1106_PosixSerial::set_drain(bool drain) {
+    this->drain = drain;
+}
+
+
+/* Read bytes received by the kernel */
+int CM1106_PosixSerial::fill() {
+
+    if (fd < 0) {
+        return -1;
+    }
+
+    // Move pending bytes to start of buffer
+    if (buf_head > 0) {
+        memmove(buf, &buf[buf_head], buf_count);
+        buf_head = 0;
+    }
+
+    if (buf_count >= CM1106_POSIX_LEN_BUF) {
+        return 0;
+    }
+
+    ssize_t nb = ::read(fd, &buf[buf_count], CM1106_POSIX_LEN_BUF - buf_count);
+    if (nb > 0) {
+        buf_count += nb;
+        return nb;
+    }
+    if (nb == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+
+int CM1106_PosixSerial::available() {
+    if (buf_count == 0) {
+        fill();
+    }
+    return buf_count;
+}
+
+
+int CM1106_PosixSerial::read() {
+
+    if (available() == 0) {
+        return -1;
+    }
+
+    uint8_t data = buf[buf_head++];
+    buf_count--;
+    if (buf_count == 0) {
+        buf_head = 0;
+    }
+
+    return data;
+}
+
+
+int CM1106_PosixSerial::peek() {
+
+    if (available() == 0) {
+        return -1;
+    }
+
+    return buf[buf_head];
+}
+
+
+size_t CM1106_PosixSerial::write(uint8_t data) {
+    return write(&data, 1);
+}
+
+
+/* Write all bytes, waiting only if the kernel buffer is full */
+size_t CM1106_PosixSerial::write(const uint8_t *buffer, size_t size) {
+    size_t done = 0;
+
+    while (fd >= 0 && done < size) {
+        ssize_t nb = ::write(fd, buffer + done, size - done);
+        if (nb > 0) {
+            done += nb;
+        } else if (nb < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            struct pollfd pfd = {fd, POLLOUT, 0};
+            ::poll(&pfd, 1, 10);
+        } else if (nb < 0 && errno == EINTR) {
+            continue;
+        } else {
+            break;
+        }
+    }
+
+    return done;
+}
+
+
+void CM1106_PosixSerial::flush() {
+    if (fd >= 0 && drain) {
+        tcdrain(fd);
+    }
+}
+
+
+/* Configure 8N1 raw mode */
+bool CM1106_PosixSerial::configure(unsigned long baudrate) {
+    struct termios tio;
+
+    if (tcgetattr(fd, &tio) < 0) {
+        return false;
+    }
+
+    cfmakeraw(&tio);
+    tio.c_cflag &= ~(CSTOPB | PARENB | CRTSCTS);
+    tio.c_cflag |= CS8 | CLOCAL | CREAD;
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+
+    speed_t speed;
+    switch (baudrate) {
+        case 9600:   speed = B9600;   break;
+        case 19200:  speed = B19200;  break;
+        case 38400:  speed = B38400;  break;
+        case 57600:  speed = B57600;  break;
+        case 115200: speed = B115200; break;
+        default:     return false;
+    }
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+
+    if (tcsetattr(fd, TCSANOW, &tio) < 0) {
+        return false;
+    }
+    tcflush(fd, TCIOFLUSH);
+
+    return true;
+}
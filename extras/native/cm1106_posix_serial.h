@@ -0,0 +1,75 @@
+/*
+    CM1106 Library for serial communication (UART)
+
+Copyright (c) 2021 Josep Comas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/    
+
+
+#ifndef _CM1106_POSIX_SERIAL
+    #define _CM1106_POSIX_SERIAL
+
+    #include "Arduino.h"
+    #include "cm1106_uart.h"
+
+    #define CM1106_POSIX_LEN_BUF   64   // Size of receive buffer
+
+
+    /* Stream over a POSIX serial port (termios file descriptor), configured at 8N1 in raw mode.
+       Reads never block: available() takes the bytes already received by the kernel.
+       flush() does not wait the end of transmission unless set_drain(true) is used. */
+    class CM1106_PosixSerial : public Stream
+    {
+        public:
+            CM1106_PosixSerial();                                               // Initialize
+            ~CM1106_PosixSerial();
+            bool begin(const char *device, unsigned long baudrate = CM1106_BAUDRATE); // Open and configure serial port
+            bool begin(int fd, bool configure);                                 // Use an open descriptor (pseudo terminal...)
+            void end();                                                         // Close serial port
+            int get_fd();                                                       // Get file descriptor
+            void set_drain(bool drain);                                         // Wait end of transmission in flush()
+            int fill();                                                         // Read bytes received by the kernel, -1 if port is closed
+
+            /* Stream */
+            int available() override;
+            int read() override;
+            int peek() override;
+            size_t write(uint8_t data) override;
+            size_t write(const uint8_t *buffer, size_t size) override;
+            using Print::write;
+            void flush() override;
+
+        private:
+            int fd;                                                             // File descriptor
+            bool own_fd;                                                        // Descriptor is closed by end()
+            bool drain;                                                         // Wait end of transmission in flush()
+            uint8_t buf[CM1106_POSIX_LEN_BUF];                                  // Received bytes
+            uint8_t buf_head;                                                   // Next byte to read
+            uint8_t buf_count;                                                  // Bytes in buffer
+
+            bool configure(unsigned long baudrate);                             // Configure 8N1 raw mode
+    };
+
+
+    /* Driver on a POSIX serial port */
+    typedef CM1106_UART_T<CM1106_PosixSerial> CM1106_PosixUART;
+
+#endif
@@ -0,0 +1,143 @@
+/*
+    CM1106 Library for serial communication (UART)
+
+Copyright (c) 2021 Josep Comas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include "cm1106_pty_bridge.h"
+#include "cm1106_uart.h"
+
+#ifdef __linux__
+
+#include <pty.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#define CM1106_PTY_LEN_BUF   64   // Bytes moved at once
+
+
+/* Initialize */
+CM1106_PtyBridge::CM1106_PtyBridge()
+{
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    running = false;
+}
+
+
+CM1106_PtyBridge::~CM1106_PtyBridge() {
+    stop();
+    for (size_t i = 0; i < masters.size(); i++) {
+        close(masters[i]);
+        close(slaves[i]);
+    }
+    if (epfd >= 0) {
+        close(epfd);
+    }
+}
+
+
+/* Create an emulated sensor */
+int CM1106_PtyBridge::add(uint8_t model) {
+    int master, slave;
+
+    if (running || openpty(&master, &slave, NULL, NULL, NULL) < 0) {
+        return -1;
+    }
+
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.u32 = emulators.size();
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, master, &event) < 0) {
+        close(master);
+        close(slave);
+        return -1;
+    }
+
+    masters.push_back(master);
+    slaves.push_back(slave);
+    emulators.emplace_back(new CM1106_Emulator(model));
+
+    return slave;
+}
+
+
+/* Get emulated sensor */
+CM1106_Emulator *CM1106_PtyBridge::get_emulator(size_t index) {
+    return index < emulators.size() ? emulators[index].get() : NULL;
+}
+
+
+/* Get number of emulated sensors */
+size_t CM1106_PtyBridge::get_count() {
+    return emulators.size();
+}
+
+
+/* Start background thread */
+void CM1106_PtyBridge::start() {
+    if (!running) {
+        running = true;
+        thread = std::thread(&CM1106_PtyBridge::run, this);
+    }
+}
+
+
+/* Stop background thread */
+void CM1106_PtyBridge::stop() {
+    if (running) {
+        running = false;
+        thread.join();
+    }
+}
+
+
+/* Move bytes between emulators and pseudo terminals */
+void CM1106_PtyBridge::run() {
+    epoll_event events[64];
+    uint8_t buffer[CM1106_PTY_LEN_BUF];
+
+    while (running) {
+        // Requests to emulators
+        int nb = epoll_wait(epfd, events, 64, 1);
+        for (int i = 0; i < nb; i++) {
+            uint32_t index = events[i].data.u32;
+            ssize_t len = ::read(masters[index], buffer, sizeof(buffer));
+            if (len > 0) {
+                emulators[index]->write(buffer, len);
+            }
+        }
+
+        // Responses to serial ports, as bytes become available
+        for (size_t i = 0; i < emulators.size(); i++) {
+            size_t len = 0;
+            while (len < sizeof(buffer) && emulators[i]->available()) {
+                buffer[len++] = emulators[i]->read();
+            }
+            if (len > 0 && ::write(masters[i], buffer, len) < 0) {
+                CM1106_LOG("DEBUG: Error writing to pseudo terminal %d!\n", (int)i);
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,64 @@
+/*
+    CM1106 Library for serial communication (UART)
+
+Copyright (c) 2021 Josep Comas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/    
+
+
+#if !defined(_CM1106_PTY_BRIDGE) && defined(__linux__)
+    #define _CM1106_PTY_BRIDGE
+
+    #include <atomic>
+    #include <memory>
+    #include <thread>
+    #include <vector>
+
+    #include "cm1106_emulator.h"
+
+
+    /* Emulated sensors behind pseudo terminal pairs (Linux).
+       Each sensor is a CM1106_Emulator connected to the master side of a pseudo terminal,
+       the slave side is a serial port to be opened by the library. A background thread
+       moves requests and responses between both sides. */
+    class CM1106_PtyBridge
+    {
+        public:
+            CM1106_PtyBridge();                                                 // Initialize
+            ~CM1106_PtyBridge();
+            int add(uint8_t model = CM1106_EMU_MODEL_CM1106);                   // Create an emulated sensor, return slave descriptor (-1 on error)
+            CM1106_Emulator *get_emulator(size_t index);                        // Get emulated sensor (to configure it before start)
+            size_t get_count();                                                 // Get number of emulated sensors
+            void start();                                                       // Start background thread
+            void stop();                                                        // Stop background thread
+
+        private:
+            int epfd;                                                           // epoll descriptor of master sides
+            std::vector<int> masters;                                           // Master sides
+            std::vector<int> slaves;                                            // Slave sides
+            std::vector<std::unique_ptr<CM1106_Emulator>> emulators;            // Emulated sensors
+            std::atomic<bool> running;
+            std::thread thread;
+
+            void run();                                                         // Move bytes between emulators and pseudo terminals
+    };
+
+#endif
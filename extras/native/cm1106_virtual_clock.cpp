@@ -0,0 +1,74 @@
+/*
+    CM1106 Library for serial communication (UART)
+
+Copyright (c) 2021 Josep Comas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include "cm1106_virtual_clock.h"
+#include <thread>
+
+
+/* Initialize */
+CM1106_VirtualClock::CM1106_VirtualClock(uint64_t start_us)
+{
+    time_us = start_us;
+    tick_us = CM1106_VCLOCK_TICK;
+}
+
+
+unsigned long CM1106_VirtualClock::now_ms() {
+    return (unsigned long)(now_us() / 1000);
+}
+
+
+/* Current time, moved forward one tick */
+unsigned long CM1106_VirtualClock::now_us() {
+    return (unsigned long)(time_us.fetch_add(tick_us) + tick_us);
+}
+
+
+void CM1106_VirtualClock::sleep_ms(unsigned long ms) {
+    advance((uint64_t)ms * 1000);
+}
+
+
+/* Other threads may share the clock, a busy wait skips ahead so it takes few yields */
+void CM1106_VirtualClock::idle() {
+    time_us += CM1106_VCLOCK_IDLE;
+    std::this_thread::yield();
+}
+
+
+void CM1106_VirtualClock::advance(uint64_t us) {
+    time_us += us;
+}
+
+
+uint64_t CM1106_VirtualClock::get_time() {
+    return time_us;
+}
+
+
+void CM1106_VirtualClock::set_tick(uint32_t tick_us) {
+    this->tick_us = tick_us;
+}
@@ -0,0 +1,59 @@
+/*
+    CM1106 Library for serial communication (UART)
+
+Copyright (c) 2021 Josep Comas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/    
+
+
+#ifndef _CM1106_VIRTUAL_CLOCK
+    #define _CM1106_VIRTUAL_CLOCK
+
+    #include "cm1106_clock.h"
+    #include <atomic>
+
+    #define CM1106_VCLOCK_TICK           1   // Default time (us) elapsed on each reading of the clock
+    #define CM1106_VCLOCK_IDLE          50   // Time (us) elapsed on each idle() of a busy wait
+
+
+    /* Virtual clock for native builds: time only moves when it is read (a tick, so busy waits
+       end), on idle() inside busy waits and on sleeps, which take no real time. Installed with cm1106_set_clock(), the
+       library and CM1106_Emulator follow it, e.g. a week of operation runs in a fraction of a second.
+       CM1106_Epoll and CM1106_Reactor wait on the kernel and need the Arduino clock. */
+    class CM1106_VirtualClock : public CM1106_Clock
+    {
+        public:
+            CM1106_VirtualClock(uint64_t start_us = 0);                         // Initialize
+            unsigned long now_ms() override;
+            unsigned long now_us() override;
+            void sleep_ms(unsigned long ms) override;
+            void idle() override;
+
+            void advance(uint64_t us);                                          // Move time forward (e.g. sleep of the host)
+            uint64_t get_time();                                                // Get time (us) without moving it
+            void set_tick(uint32_t tick_us);                                    // Set time elapsed on each reading of the clock
+
+        private:
+            std::atomic<uint64_t> time_us;                                      // Current time (us)
+            uint32_t tick_us;
+    };
+
+#endif
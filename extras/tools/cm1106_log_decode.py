@@ -0,0 +1,122 @@
+#!/usr/bin/env python3
+"""
+Decode the deferred log of CM1106 Library (CM1106_LOG_DEFERRED).
+
+Records are dumped by cm1106_log_dump() as lines "CM1106LOG <hex>". Each record holds
+the FNV-1a hash of its format string, which is found again by scanning the CM1106_LOG()
+calls of the sources.
+
+    python3 cm1106_log_decode.py [--src DIR ...] [capture.txt]
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+MARK = "CM1106LOG "
+LEN_MASK = 0x7F     # Length of a record in its first byte
+TRUNCATED = 0x80    # Flag of first byte: arguments left out, record was full
+LOG_CALL = re.compile(r'CM1106_LOG\(\s*"((?:[^"\\]|\\.)*)"')
+ESCAPES = {"n": "\n", "t": "\t", "r": "\r", "\\": "\\", '"': '"', "'": "'", "0": "\0"}
+
+
+def fnv1a(data):
+    h = 2166136261
+    for b in data:
+        h = ((h ^ b) * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def unescape(literal):
+    return re.sub(r"\\(.)", lambda m: ESCAPES.get(m.group(1), m.group(1)), literal)
+
+
+def load_formats(dirs):
+    formats = {}
+    for top in dirs:
+        for root, _, files in os.walk(top):
+            for name in files:
+                if not name.endswith((".cpp", ".h")):
+                    continue
+                with open(os.path.join(root, name), encoding="utf-8", errors="replace") as f:
+                    for literal in LOG_CALL.findall(f.read()):
+                        text = unescape(literal)
+                        formats[fnv1a(text.encode("latin-1"))] = text
+    return formats
+
+
+def decode_args(data):
+    args = []
+    pos = 0
+    while pos < len(data):
+        tag = chr(data[pos])
+        if tag == "i":
+            args.append(struct.unpack_from("<i", data, pos + 1)[0])
+            pos += 5
+        elif tag == "u":
+            args.append(struct.unpack_from("<I", data, pos + 1)[0])
+            pos += 5
+        elif tag in "sb":
+            size = data[pos + 1]
+            raw = data[pos + 2:pos + 2 + size]
+            if tag == "s":
+                args.append(raw.decode("latin-1"))
+            else:
+                args.append("".join("0x%02x " % b for b in raw))
+            pos += 2 + size
+        else:
+            raise ValueError("unknown argument tag 0x%02x" % data[pos])
+    return args
+
+
+def decode_record(record, formats):
+    length, timestamp, ident = struct.unpack_from("<BII", record)
+    if length & LEN_MASK != len(record):
+        raise ValueError("bad record length")
+    text = formats.get(ident)
+    args = decode_args(record[9:])
+    if text is None:
+        return timestamp, "<unknown format 0x%08x> %r\n" % (ident, args)
+    if length & TRUNCATED:
+        # Arguments missing, the format can not be applied
+        return timestamp, "<truncated> %r %r\n" % (text.rstrip("\n"), args)
+    return timestamp, text % tuple(args)
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--src", action="append", help="source directory (default: src and extras/native of the library)")
+    parser.add_argument("capture", nargs="?", help="captured output (default: stdin)")
+    options = parser.parse_args()
+
+    formats = load_formats(options.src or [os.path.join(here, "..", "..", "src"), os.path.join(here, "..", "native")])
+    capture = open(options.capture, encoding="utf-8", errors="replace") if options.capture else sys.stdin
+
+    # Messages without end of line continue in the next record, as with printf
+    line, line_time = "", None
+    for raw in capture:
+        pos = raw.find(MARK)
+        if pos < 0:
+            continue
+        try:
+            timestamp, text = decode_record(bytes.fromhex(raw[pos + len(MARK):].strip()), formats)
+        except (ValueError, struct.error, TypeError) as error:
+            print("<bad record: %s>" % error)
+            continue
+        if line_time is None:
+            line_time = timestamp
+        line += text
+        while "\n" in line:
+            message, line = line.split("\n", 1)
+            print("[%10.3f ms] %s" % (line_time / 1000.0, message))
+            line_time = timestamp if line else None
+
+    if line:
+        print("[%10.3f ms] %s" % (line_time / 1000.0, line))
+
+
+if __name__ == "__main__":
+    main()
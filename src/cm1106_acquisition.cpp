@@ -0,0 +1,197 @@
+/*
+    CM1106 Library for serial communication (UART)
+
+Copyright (c) 2021 Josep Comas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include "cm1106_acquisition.h"
+
+#ifdef CM1106_ACQUISITION_SUPPORTED
+
+/* Initialize */
+CM1106_Acquisition::CM1106_Acquisition(CM1106_Protocol &sensor, uint32_t period_ms)
+{
+    this->sensor = &sensor;
+    this->period_ms = period_ms;
+    filter = NULL;
+    running = false;
+    overruns = 0;
+    latest_seq = 0;
+    latest_timestamp = 0;
+    latest_co2 = 0;
+    latest_status = CM1106_READING_ERROR;
+#ifdef ARDUINO_ARCH_ESP32
+    task_handle = NULL;
+    finished = true;
+#endif
+}
+
+
+CM1106_Acquisition::~CM1106_Acquisition() {
+    stop();
+}
+
+
+/* Set filter chain applied before publishing readings */
+void CM1106_Acquisition::set_filter(CM1106_Filter *filter) {
+    this->filter = filter;
+}
+
+
+/* Start sampling */
+bool CM1106_Acquisition::start() {
+
+    if (running) {
+        return false;
+    }
+    running = true;
+
+#ifdef ARDUINO_ARCH_ESP32
+    finished = false;
+    if (xTaskCreatePinnedToCore(task, "cm1106", CM1106_ACQ_STACK, this, CM1106_ACQ_PRIORITY, &task_handle, CM1106_ACQ_CORE) != pdPASS) {
+        CM1106_LOG("DEBUG: Acquisition task not created!\n");
+        running = false;
+        finished = true;
+        return false;
+    }
+#else
+    worker = std::thread(&CM1106_Acquisition::run, this);
+#endif
+
+    return true;
+}
+
+
+/* Stop sampling and wait end of task */
+void CM1106_Acquisition::stop() {
+
+    running = false;
+
+#ifdef ARDUINO_ARCH_ESP32
+    while (!finished) {
+        vTaskDelay(1);
+    }
+#else
+    if (worker.joinable()) {
+        worker.join();
+    }
+#endif
+}
+
+
+/* Get latest reading */
+bool CM1106_Acquisition::get_latest(CM1106_reading *reading) {
+    uint32_t seq;
+
+    // Retry if the reading was being written
+    do {
+        seq = latest_seq.load(std::memory_order_acquire);
+        if (seq == 0) {
+            return false;
+        }
+        reading->timestamp = latest_timestamp.load(std::memory_order_relaxed);
+        reading->co2 = latest_co2.load(std::memory_order_relaxed);
+        reading->status = latest_status.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((seq & 1) || seq != latest_seq.load(std::memory_order_relaxed));
+
+    return true;
+}
+
+
+/* Take oldest reading of history */
+bool CM1106_Acquisition::pop(CM1106_reading *reading) {
+    return history.pop(reading);
+}
+
+
+/* Get readings lost because history was full */
+uint32_t CM1106_Acquisition::get_overruns() {
+    return overruns;
+}
+
+
+#ifdef ARDUINO_ARCH_ESP32
+/* Entry of FreeRTOS task */
+void CM1106_Acquisition::task(void *arg) {
+    CM1106_Acquisition *acquisition = (CM1106_Acquisition *)arg;
+    acquisition->run();
+    acquisition->finished = true;
+    vTaskDelete(NULL);
+}
+#endif
+
+
+/* Sampling loop */
+void CM1106_Acquisition::run() {
+
+#ifdef ARDUINO_ARCH_ESP32
+    TickType_t last_wake = xTaskGetTickCount();
+    TickType_t period_ticks = pdMS_TO_TICKS(period_ms) > 0 ? pdMS_TO_TICKS(period_ms) : 1;
+    while (running) {
+        sample();
+        vTaskDelayUntil(&last_wake, period_ticks);
+    }
+#else
+    unsigned long next_ms = cm1106_millis();
+    while (running) {
+        sample();
+        next_ms += period_ms;
+        while (running && (long)(next_ms - cm1106_millis()) > 0) {
+            unsigned long wait_ms = next_ms - cm1106_millis();
+            cm1106_delay(wait_ms < 10 ? wait_ms : 10);
+        }
+    }
+#endif
+}
+
+
+/* Take and publish a reading */
+void CM1106_Acquisition::sample() {
+    CM1106_reading reading;
+    int16_t co2;
+
+    bool ok = sensor->get_co2(&co2);
+    reading.timestamp = cm1106_millis();
+    reading.co2 = ok ? co2 : 0;
+    reading.status = ok ? CM1106_READING_OK : CM1106_READING_ERROR;
+    if (filter != NULL) {
+        filter->process(&reading);
+    }
+
+    // Latest reading (sequence lock, single writer, fields are atomic as the reader may copy them while written)
+    uint32_t seq = latest_seq.load(std::memory_order_relaxed);
+    latest_seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    latest_timestamp.store(reading.timestamp, std::memory_order_relaxed);
+    latest_co2.store(reading.co2, std::memory_order_relaxed);
+    latest_status.store(reading.status, std::memory_order_relaxed);
+    latest_seq.store(seq + 2, std::memory_order_release);
+
+    // History
+    if (!history.push(reading)) {
+        overruns++;
+    }
+}
+
+#endif
@@ -0,0 +1,94 @@
+/*
+    CM1106 Library for serial communication (UART)
+
+Copyright (c) 2021 Josep Comas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/    
+
+
+#ifndef _CM1106_ACQUISITION
+    #define _CM1106_ACQUISITION
+
+    #include "cm1106_uart.h"
+    #include "cm1106_filter.h"
+
+    #if defined ARDUINO_ARCH_ESP32 || defined CM1106_NATIVE
+        #define CM1106_ACQUISITION_SUPPORTED
+    #endif
+
+    #ifdef CM1106_ACQUISITION_SUPPORTED
+
+        #include "cm1106_spsc.h"
+
+        #ifdef ARDUINO_ARCH_ESP32
+            #include <freertos/FreeRTOS.h>
+            #include <freertos/task.h>
+        #else
+            #include <thread>
+        #endif
+
+        #define CM1106_ACQ_HISTORY        64   // Readings kept for consumers (power of 2)
+        #define CM1106_ACQ_STACK        4096   // Stack size of acquisition task (ESP32)
+        #define CM1106_ACQ_PRIORITY        1   // Priority of acquisition task (ESP32)
+        #define CM1106_ACQ_CORE            0   // Core of acquisition task (ESP32)
+
+
+        /* Background acquisition of CO2 readings. A FreeRTOS task (ESP32) or a thread (native)
+           samples the sensor periodically, readings are published to consumers without locks:
+           latest value and history in a single producer/single consumer ring. */
+        class CM1106_Acquisition
+        {
+            public:
+                CM1106_Acquisition(CM1106_Protocol &sensor, uint32_t period_ms);  // Initialize
+                ~CM1106_Acquisition();
+                void set_filter(CM1106_Filter *filter);                         // Set filter chain applied before publishing readings (NULL = none), before start()
+                bool start();                                                   // Start sampling
+                void stop();                                                    // Stop sampling and wait end of task
+                bool get_latest(CM1106_reading *reading);                       // Get latest reading (false if none yet)
+                bool pop(CM1106_reading *reading);                              // Take oldest reading of history (false if empty)
+                uint32_t get_overruns();                                        // Get readings lost because history was full
+
+            private:
+                CM1106_Protocol *sensor;                                        // Sampled sensor
+                uint32_t period_ms;                                             // Sampling period
+                CM1106_Filter *filter;                                          // Filter chain of readings
+                std::atomic<bool> running;                                      // Task must keep running
+                std::atomic<uint32_t> overruns;                                 // Readings lost
+                CM1106_SPSC<CM1106_reading, CM1106_ACQ_HISTORY> history;        // History of readings
+                std::atomic<uint32_t> latest_seq;                               // Sequence lock of latest reading (odd while writing)
+                std::atomic<uint32_t> latest_timestamp;                         // Latest reading, field by field: read while written
+                std::atomic<int16_t> latest_co2;
+                std::atomic<uint8_t> latest_status;
+
+#ifdef ARDUINO_ARCH_ESP32
+                TaskHandle_t task_handle;
+                std::atomic<bool> finished;
+                static void task(void *arg);                                    // Entry of FreeRTOS task
+#else
+                std::thread worker;
+#endif
+                void run();                                                     // Sampling loop
+                void sample();                                                  // Take and publish a reading
+        };
+
+    #endif
+
+#endif
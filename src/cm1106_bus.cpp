@@ -0,0 +1,169 @@
+/*
+    CM1106 Library for serial communication (UART)
+
+Copyright (c) 2021 Josep Comas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include "cm1106_bus.h"
+
+
+/* Initialize */
+CM1106_Bus::CM1106_Bus()
+{
+    count = 0;
+    nb_pending = 0;
+}
+
+
+/* Add a sensor */
+bool CM1106_Bus::add(CM1106_Protocol &sensor) {
+
+    if (count >= CM1106_BUS_MAX) {
+        CM1106_LOG("DEBUG: Bus is full!\n");
+        return false;
+    }
+
+    sensors[count] = &sensor;
+    filters[count] = NULL;
+    pending[count] = false;
+    readings[count].timestamp = 0;
+    readings[count].co2 = 0;
+    readings[count].status = CM1106_READING_ERROR;
+    count++;
+
+    return true;
+}
+
+
+/* Get number of sensors */
+uint8_t CM1106_Bus::get_count() {
+    return count;
+}
+
+
+/* Send CO2 request to all sensors */
+bool CM1106_Bus::begin_sweep() {
+
+    if (nb_pending > 0) {
+        CM1106_LOG("DEBUG: Sweep already in progress!\n");
+        return false;
+    }
+
+    for (uint8_t i = 0; i < count; i++) {
+        readings[i].co2 = 0;
+        readings[i].status = CM1106_READING_ERROR;
+        pending[i] = sensors[i]->begin_get_co2();
+        if (pending[i]) {
+            nb_pending++;
+        } else {
+            finish(i);
+        }
+    }
+
+    return true;
+}
+
+
+/* Process received bytes of all sensors */
+bool CM1106_Bus::poll() {
+
+    for (uint8_t i = 0; i < count && nb_pending > 0; i++) {
+        if (!pending[i]) {
+            continue;
+        }
+
+        uint8_t status = sensors[i]->poll();
+        if (status == CM1106_POLL_PENDING) {
+            continue;
+        }
+
+        if (status == CM1106_POLL_READY) {
+            readings[i].co2 = sensors[i]->get_last_co2();
+            readings[i].status = CM1106_READING_OK;
+        }
+        finish(i);
+        pending[i] = false;
+        nb_pending--;
+    }
+
+    return nb_pending == 0;
+}
+
+
+/* Read all sensors waiting responses */
+uint8_t CM1106_Bus::sweep(CM1106_reading readings[]) {
+    uint8_t valid = 0;
+
+    if (!begin_sweep()) {
+        return 0;
+    }
+
+    while (!poll()) {
+        cm1106_yield();
+    }
+
+    for (uint8_t i = 0; i < count; i++) {
+        if (readings != NULL) {
+            readings[i] = this->readings[i];
+        }
+        if (this->readings[i].status == CM1106_READING_OK) {
+            valid++;
+        }
+    }
+
+    return valid;
+}
+
+
+/* Get reading of a sensor in last sweep */
+bool CM1106_Bus::get_reading(uint8_t index, CM1106_reading *reading) {
+
+    if (index >= count || reading == NULL) {
+        return false;
+    }
+
+    *reading = readings[index];
+
+    return readings[index].status == CM1106_READING_OK;
+}
+
+
+/* Set filter chain of readings of a sensor */
+bool CM1106_Bus::set_filter(uint8_t index, CM1106_Filter *filter) {
+
+    if (index >= count) {
+        return false;
+    }
+
+    filters[index] = filter;
+    return true;
+}
+
+
+/* Timestamp and filter reading of a sensor */
+void CM1106_Bus::finish(uint8_t index) {
+    readings[index].timestamp = cm1106_millis();
+    if (filters[index] != NULL) {
+        filters[index]->process(&readings[index]);
+    }
+}
@@ -0,0 +1,62 @@
+/*
+    CM1106 Library for serial communication (UART)
+
+Copyright (c) 2021 Josep Comas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/    
+
+
+#ifndef _CM1106_BUS
+    #define _CM1106_BUS
+
+    #include "cm1106_uart.h"
+    #include "cm1106_filter.h"
+
+    #define CM1106_BUS_MAX   8   // Max number of sensors of a bus
+
+
+    /* Read several sensors, each one on its own serial port, at the same time.
+       CO2 requests are sent to all sensors and their responses are processed as bytes
+       arrive, so a sweep takes as long as the slowest sensor instead of the sum of all. */
+    class CM1106_Bus
+    {
+        public:
+            CM1106_Bus();                                                       // Initialize
+            bool add(CM1106_Protocol &sensor);                                  // Add a sensor (false if bus is full)
+            uint8_t get_count();                                                // Get number of sensors
+            bool begin_sweep();                                                 // Send CO2 request to all sensors
+            bool poll();                                                        // Process received bytes, true when sweep is complete
+            uint8_t sweep(CM1106_reading readings[]);                           // Read all sensors waiting responses, return number of valid readings
+            bool get_reading(uint8_t index, CM1106_reading *reading);           // Get reading of a sensor in last sweep
+            bool set_filter(uint8_t index, CM1106_Filter *filter);              // Set filter chain of readings of a sensor (NULL = none)
+
+        private:
+            CM1106_Protocol *sensors[CM1106_BUS_MAX];                           // Sensors of the bus
+            CM1106_reading readings[CM1106_BUS_MAX];                            // Readings of last sweep
+            CM1106_Filter *filters[CM1106_BUS_MAX];                             // Filter chain of each sensor
+            bool pending[CM1106_BUS_MAX];                                       // Sensor has not answered yet
+            uint8_t count;                                                      // Number of sensors
+            uint8_t nb_pending;                                                 // Sensors not answered yet
+
+            void finish(uint8_t index);                                         // Timestamp and filter reading of a sensor
+    };
+
+#endif
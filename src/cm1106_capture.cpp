@@ -0,0 +1,316 @@
+/*
+    CM1106 Library for serial communication (UART)
+
+Copyright (c) 2021 Josep Comas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include "cm1106_capture.h"
+
+
+/* Initialize */
+CM1106_Capture::CM1106_Capture(Stream &target, Print &sink)
+{
+    this->target = &target;
+    this->sink = &sink;
+    last_us = 0;
+    chunk_type = CM1106_CAP_TX;
+    chunk_nb = 0;
+    chunk_us = 0;
+    records = 0;
+}
+
+
+/* Start capture */
+void CM1106_Capture::begin(bool header) {
+
+    if (header) {
+        uint8_t buf[CM1106_CAP_LEN_HEADER] = {0};
+        memcpy(buf, CM1106_CAP_MAGIC, strlen(CM1106_CAP_MAGIC));
+        buf[CM1106_CAP_LEN_HEADER - 2] = CM1106_CAP_VERSION;
+        sink->write(buf, sizeof(buf));
+    }
+
+    chunk_nb = 0;
+    last_us = cm1106_micros();
+}
+
+
+uint32_t CM1106_Capture::get_records() {
+    return records;
+}
+
+
+int CM1106_Capture::available() {
+    return target->available();
+}
+
+
+int CM1106_Capture::read() {
+    int data = target->read();
+    if (data >= 0) {
+        add(CM1106_CAP_RX, data);
+    }
+    return data;
+}
+
+
+int CM1106_Capture::peek() {
+    return target->peek();
+}
+
+
+size_t CM1106_Capture::write(uint8_t data) {
+    return write(&data, 1);
+}
+
+
+/* Bytes of one write are a record, written with its time of start */
+size_t CM1106_Capture::write(const uint8_t *buffer, size_t size) {
+
+    if (chunk_nb > 0) {
+        write_record();
+    }
+
+    unsigned long start = cm1106_micros();
+    size_t n = target->write(buffer, size);
+    for (size_t i = 0; i < n; i++) {
+        add(CM1106_CAP_TX, buffer[i]);
+    }
+    if (chunk_nb > 0) {
+        chunk_us = start;
+        write_record();
+    }
+
+    return n;
+}
+
+
+void CM1106_Capture::flush() {
+    target->flush();
+    if (chunk_nb > 0) {
+        write_record();
+    }
+    sink->flush();
+}
+
+
+/* Add a byte to current record, a pause starts a new record */
+void CM1106_Capture::add(uint8_t type, uint8_t data) {
+    unsigned long now = cm1106_micros();
+
+    if (chunk_nb > 0 && (chunk_type != type || chunk_nb >= CM1106_CAP_MAX_CHUNK || now - chunk_us > CM1106_CAP_GAP)) {
+        write_record();
+    }
+
+    chunk_type = type;
+    chunk_us = now;
+    chunk[chunk_nb++] = data;
+}
+
+
+/* Write collected record to sink */
+void CM1106_Capture::write_record() {
+    uint8_t header[1 + 5];
+    uint8_t nb = 0;
+
+    header[nb++] = chunk_type | chunk_nb;
+
+    // Time since previous record (LEB128)
+    uint32_t delta = chunk_us - last_us;
+    do {
+        uint8_t b = delta & 0x7F;
+        delta >>= 7;
+        header[nb++] = (delta != 0) ? (b | 0x80) : b;
+    } while (delta != 0);
+
+    sink->write(header, nb);
+    sink->write(chunk, chunk_nb);
+
+    last_us = chunk_us;
+    chunk_nb = 0;
+    records++;
+}
+
+
+/* Initialize with a capture */
+CM1106_Replay::CM1106_Replay(const uint8_t *data, size_t size)
+{
+    this->data = data;
+    this->size = size;
+    realtime = true;
+    type = CM1106_CAP_TX;
+    payload = NULL;
+    len = 0;
+    consumed = 0;
+    record_us = 0;
+    anchor_record_us = 0;
+    anchor_us = cm1106_micros();
+    mismatches = 0;
+    skipped = 0;
+
+    valid = size >= CM1106_CAP_LEN_HEADER && memcmp(data, CM1106_CAP_MAGIC, strlen(CM1106_CAP_MAGIC)) == 0 &&
+            data[CM1106_CAP_LEN_HEADER - 2] == CM1106_CAP_VERSION;
+    next = CM1106_CAP_LEN_HEADER;
+    if (!valid) {
+        CM1106_LOG("DEBUG: Invalid capture!\n");
+        next = size;
+    }
+    load();
+}
+
+
+bool CM1106_Replay::is_valid() {
+    return valid;
+}
+
+
+void CM1106_Replay::set_realtime(bool realtime) {
+    this->realtime = realtime;
+}
+
+
+bool CM1106_Replay::is_finished() {
+    return payload == NULL;
+}
+
+
+uint32_t CM1106_Replay::get_mismatches() {
+    return mismatches;
+}
+
+
+uint32_t CM1106_Replay::get_skipped() {
+    return skipped;
+}
+
+
+size_t CM1106_Replay::get_position() {
+    return next;
+}
+
+
+/* Bytes of recorded response already due */
+int CM1106_Replay::available() {
+    if (payload == NULL || type != CM1106_CAP_RX || !due()) {
+        return 0;
+    }
+    return len - consumed;
+}
+
+
+int CM1106_Replay::read() {
+    if (available() == 0) {
+        return -1;
+    }
+
+    uint8_t b = payload[consumed++];
+    if (consumed == len) {
+        load();
+    }
+    return b;
+}
+
+
+int CM1106_Replay::peek() {
+    if (available() == 0) {
+        return -1;
+    }
+    return payload[consumed];
+}
+
+
+/* Match byte with recorded request, responses not read before are skipped */
+size_t CM1106_Replay::write(uint8_t data) {
+
+    while (payload != NULL && type == CM1106_CAP_RX) {
+        skipped += len - consumed;
+        load();
+    }
+    if (payload == NULL) {
+        return 1;
+    }
+
+    if (consumed == 0) {
+        anchor_record_us = record_us;
+        anchor_us = cm1106_micros();
+    }
+    if (payload[consumed] != data) {
+        mismatches++;
+    }
+    consumed++;
+    if (consumed == len) {
+        load();
+    }
+
+    return 1;
+}
+
+
+void CM1106_Replay::flush() {
+}
+
+
+/* Decode next record */
+bool CM1106_Replay::load() {
+
+    payload = NULL;
+    consumed = 0;
+    if (next >= size) {
+        return false;
+    }
+
+    uint8_t first = data[next++];
+    type = first & CM1106_CAP_TYPE_MASK;
+    len = first & ~CM1106_CAP_TYPE_MASK;
+
+    uint32_t delta = 0;
+    uint8_t shift = 0;
+    while (next < size && shift < 35) {
+        uint8_t b = data[next++];
+        delta |= (uint32_t)(b & 0x7F) << shift;
+        shift += 7;
+        if ((b & 0x80) == 0) {
+            break;
+        }
+    }
+
+    if (len == 0 || len > size - next) {
+        CM1106_LOG("DEBUG: Truncated capture!\n");
+        next = size;
+        return false;
+    }
+
+    record_us += delta;
+    payload = &data[next];
+    next += len;
+    return true;
+}
+
+
+/* Check if current response must be available: same delay after request as in capture */
+bool CM1106_Replay::due() {
+    if (!realtime) {
+        return true;
+    }
+    return cm1106_micros() - anchor_us >= record_us - anchor_record_us;
+}
@@ -0,0 +1,121 @@
+/*
+    CM1106 Library for serial communication (UART)
+
+Copyright (c) 2021 Josep Comas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/    
+
+
+#ifndef _CM1106_CAPTURE
+    #define _CM1106_CAPTURE
+
+    #include "cm1106_uart.h"
+
+    /* Capture format: header, then records appended as traffic happens
+         header: "CM1106" CM1106_CAP_VERSION 0x00
+         record: type | length (1 byte), time since previous record (us, LEB128 varint), bytes */
+    #define CM1106_CAP_MAGIC      "CM1106"   // Start of header
+    #define CM1106_CAP_VERSION           1   // Version of format
+    #define CM1106_CAP_LEN_HEADER        8   // Length of header
+    #define CM1106_CAP_TX             0x00   // Record of bytes sent to the sensor
+    #define CM1106_CAP_RX             0x40   // Record of bytes received from the sensor
+    #define CM1106_CAP_TYPE_MASK      0xC0   // Type of record in first byte
+    #define CM1106_CAP_MAX_CHUNK        63   // Max bytes of a record (length in first byte)
+    #define CM1106_CAP_GAP            2000   // Pause (us) between received bytes which starts a new record
+
+
+    /* Stream between a driver and its serial port which records all traffic to a sink (file, SD card,
+       console...). Bytes sent by one write are a record with the time of the write; bytes read without
+       a pause longer than CM1106_CAP_GAP are a record with the time of its last byte, when the
+       driver could see the whole chunk. */
+    class CM1106_Capture : public Stream
+    {
+        public:
+            CM1106_Capture(Stream &target, Print &sink);                        // Initialize
+            void begin(bool header = true);                                     // Start capture, write header unless appending to a capture
+            uint32_t get_records();                                             // Get number of records written
+
+            /* Stream */
+            int available() override;
+            int read() override;
+            int peek() override;
+            size_t write(uint8_t data) override;
+            size_t write(const uint8_t *buffer, size_t size) override;
+            void flush() override;
+
+        private:
+            Stream *target;                                                     // Serial port
+            Print *sink;                                                        // Destination of records
+            unsigned long last_us;                                              // Time of previous record
+            uint8_t chunk_type;                                                 // Type of record being collected
+            uint8_t chunk[CM1106_CAP_MAX_CHUNK];                                // Bytes of record being collected
+            uint8_t chunk_nb;
+            unsigned long chunk_us;                                             // Time of last byte of record being collected
+            uint32_t records;
+
+            void add(uint8_t type, uint8_t data);                               // Add a byte to current record
+            void write_record();                                                // Write collected record to sink
+    };
+
+
+    /* Stream which plays a capture back to a driver: bytes written are matched against recorded
+       requests and recorded responses become available with their original delay after the request,
+       or at once. The capture is read in place (RAM, flash or a mapped file), without copies. */
+    class CM1106_Replay : public Stream
+    {
+        public:
+            CM1106_Replay(const uint8_t *data, size_t size);                    // Initialize with a capture
+            bool is_valid();                                                    // Check header of capture
+            void set_realtime(bool realtime);                                   // Original timing (default) or as fast as possible
+            bool is_finished();                                                 // Check if all records have been played
+            uint32_t get_mismatches();                                          // Get bytes written not matching recorded requests
+            uint32_t get_skipped();                                             // Get bytes of responses skipped by a request
+            size_t get_position();                                              // Get offset of next record
+
+            /* Stream */
+            int available() override;
+            int read() override;
+            int peek() override;
+            size_t write(uint8_t data) override;
+            using Print::write;
+            void flush() override;
+
+        private:
+            const uint8_t *data;                                                // Capture
+            size_t size;
+            size_t next;                                                        // Offset of record after current one
+            bool valid;
+            bool realtime;
+            uint8_t type;                                                       // Current record
+            const uint8_t *payload;
+            uint8_t len;
+            uint8_t consumed;                                                   // Bytes of current record already played
+            uint64_t record_us;                                                 // Time of current record in capture
+            uint64_t anchor_record_us;                                          // Time in capture of last request
+            unsigned long anchor_us;                                            // Time when last request was played
+            uint32_t mismatches;
+            uint32_t skipped;
+
+            bool load();                                                        // Decode next record, false at end of capture
+            bool due();                                                         // Check if current response must be available
+    };
+
+#endif
@@ -0,0 +1,58 @@
+/*
+    CM1106 Library for serial communication (UART)
+
+Copyright (c) 2021 Josep Comas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include "cm1106_clock.h"
+
+
+static CM1106_ArduinoClock arduino_clock;
+
+CM1106_Clock *cm1106_clock = &arduino_clock;
+
+
+/* Set clock of the library */
+void cm1106_set_clock(CM1106_Clock *clock) {
+    cm1106_clock = (clock != NULL) ? clock : &arduino_clock;
+}
+
+
+unsigned long CM1106_ArduinoClock::now_ms() {
+    return millis();
+}
+
+
+unsigned long CM1106_ArduinoClock::now_us() {
+    return micros();
+}
+
+
+void CM1106_ArduinoClock::sleep_ms(unsigned long ms) {
+    delay(ms);
+}
+
+
+void CM1106_ArduinoClock::idle() {
+    yield();
+}
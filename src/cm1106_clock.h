@@ -0,0 +1,68 @@
+/*
+    CM1106 Library for serial communication (UART)
+
+Copyright (c) 2021 Josep Comas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/    
+
+
+#ifndef _CM1106_CLOCK
+    #define _CM1106_CLOCK
+
+    #include "Arduino.h"
+
+
+    /* Time source of the library: timeouts, retries, schedules and timestamps of readings.
+       The default clock is the Arduino one (millis(), micros(), delay(), yield()). Another
+       clock (e.g. a virtual clock of a native build) lets long processes such as ABC cycles,
+       measurement periods or duty cycles run faster than real time. */
+    class CM1106_Clock
+    {
+        public:
+            virtual ~CM1106_Clock() {}
+            virtual unsigned long now_ms() = 0;                                 // Milliseconds since start
+            virtual unsigned long now_us() = 0;                                 // Microseconds since start
+            virtual void sleep_ms(unsigned long ms) = 0;                        // Wait milliseconds
+            virtual void idle() = 0;                                            // Let other tasks run during a busy wait
+    };
+
+    /* Arduino time functions */
+    class CM1106_ArduinoClock : public CM1106_Clock
+    {
+        public:
+            unsigned long now_ms() override;
+            unsigned long now_us() override;
+            void sleep_ms(unsigned long ms) override;
+            void idle() override;
+    };
+
+
+    extern CM1106_Clock *cm1106_clock;                                          // Clock in use
+
+    void cm1106_set_clock(CM1106_Clock *clock);                                 // Set clock of the library (NULL = Arduino clock), before starting any request
+
+    /* Time functions used by the library */
+    inline unsigned long cm1106_millis() { return cm1106_clock->now_ms(); }
+    inline unsigned long cm1106_micros() { return cm1106_clock->now_us(); }
+    inline void cm1106_delay(unsigned long ms) { cm1106_clock->sleep_ms(ms); }
+    inline void cm1106_yield() { cm1106_clock->idle(); }
+
+#endif
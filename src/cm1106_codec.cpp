@@ -0,0 +1,262 @@
+/*
+    CM1106 Library for serial communication (UART)
+
+Copyright (c) 2021 Josep Comas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include "cm1106_codec.h"
+
+
+/* Write a varint (LEB128), return its length */
+static uint8_t write_varint(uint8_t *buf, uint32_t value) {
+    uint8_t nb = 0;
+    while (value >= 0x80) {
+        buf[nb++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    buf[nb++] = value;
+    return nb;
+}
+
+
+/* Checksum of a block */
+uint16_t cm1106_fletcher16(const uint8_t *data, size_t size) {
+    uint32_t sum1 = 0;
+    uint32_t sum2 = 0;
+
+    // Sums do not overflow before 5802 bytes, modulo once per chunk
+    while (size > 0) {
+        size_t chunk = size < 5802 ? size : 5802;
+        size -= chunk;
+        while (chunk-- > 0) {
+            sum1 += *data++;
+            sum2 += sum1;
+        }
+        sum1 %= 255;
+        sum2 %= 255;
+    }
+
+    return (sum2 << 8) | sum1;
+}
+
+
+/* Initialize with buffer of a block */
+CM1106_Encoder::CM1106_Encoder(uint8_t *block, uint8_t size)
+{
+    this->block = block;
+    this->size = size;
+    reset();
+}
+
+
+/* Append a reading */
+bool CM1106_Encoder::add(const CM1106_reading &reading) {
+
+    if (size < CM1106_CODEC_MIN_BLOCK) {
+        return false;
+    }
+
+    if (count == 0) {
+        block[3] = reading.timestamp & 0xFF;
+        block[4] = (reading.timestamp >> 8) & 0xFF;
+        block[5] = (reading.timestamp >> 16) & 0xFF;
+        block[6] = (reading.timestamp >> 24) & 0xFF;
+        block[7] = reading.co2 & 0xFF;
+        block[8] = (reading.co2 >> 8) & 0xFF;
+        block[9] = reading.status;
+    } else {
+        int32_t delta = (int32_t)(reading.timestamp - last_time);
+        uint32_t time = cm1106_zigzag(delta - last_delta);
+        uint32_t co2 = cm1106_zigzag((int32_t)reading.co2 - last_co2);
+
+        if (time < 8 && co2 < 16 && reading.status == last_status) {
+            if (pos + 1 > size - CM1106_CODEC_CHECKSUM) {
+                return false;
+            }
+            block[pos++] = (time << 4) | co2;
+        } else if (time < 64 && co2 < 256 && reading.status == last_status) {
+            if (pos + 2 > size - CM1106_CODEC_CHECKSUM) {
+                return false;
+            }
+            block[pos++] = CM1106_CODEC_MEDIUM | time;
+            block[pos++] = co2;
+        } else {
+            uint8_t sample[CM1106_CODEC_MAX_SAMPLE];
+            uint8_t nb = 1;
+            sample[0] = CM1106_CODEC_LONG;
+            nb += write_varint(&sample[nb], time);
+            nb += write_varint(&sample[nb], co2);
+            if (reading.status != last_status) {
+                sample[0] |= CM1106_CODEC_STATUS;
+                sample[nb++] = reading.status;
+            }
+            if (pos + nb > size - CM1106_CODEC_CHECKSUM) {
+                return false;
+            }
+            memcpy(&block[pos], sample, nb);
+            pos += nb;
+        }
+        last_delta = delta;
+    }
+
+    last_time = reading.timestamp;
+    last_co2 = reading.co2;
+    last_status = reading.status;
+    count++;
+
+    return true;
+}
+
+
+/* Write header and checksum */
+uint8_t CM1106_Encoder::finish() {
+
+    if (count == 0) {
+        return 0;
+    }
+
+    block[0] = CM1106_CODEC_VERSION;
+    block[1] = count;
+    block[2] = pos - CM1106_CODEC_HEADER;
+    memset(&block[pos], 0, size - pos);
+
+    uint16_t sum = cm1106_fletcher16(block, size - CM1106_CODEC_CHECKSUM);
+    block[size - 2] = sum & 0xFF;
+    block[size - 1] = sum >> 8;
+
+    return size;
+}
+
+
+/* Start a new block in the buffer */
+void CM1106_Encoder::reset() {
+    pos = CM1106_CODEC_HEADER;
+    count = 0;
+    last_time = 0;
+    last_delta = 0;
+    last_co2 = 0;
+    last_status = 0;
+}
+
+
+uint8_t CM1106_Encoder::get_count() {
+    return count;
+}
+
+
+/* Initialize with a received block */
+CM1106_Decoder::CM1106_Decoder(const uint8_t *block, uint8_t size)
+{
+    this->block = block;
+    this->size = size;
+    pos = CM1106_CODEC_HEADER;
+    index = 0;
+    last_delta = 0;
+    end = CM1106_CODEC_HEADER;
+    valid = false;
+
+    // Size checked before any access to the block
+    if (block != NULL && size >= CM1106_CODEC_MIN_BLOCK) {
+        int samples_end = CM1106_CODEC_HEADER + block[2];
+        uint16_t sum = cm1106_fletcher16(block, size - CM1106_CODEC_CHECKSUM);
+        valid = block[0] == CM1106_CODEC_VERSION && block[1] > 0 && samples_end <= size - CM1106_CODEC_CHECKSUM &&
+                block[size - 2] == (sum & 0xFF) && block[size - 1] == (sum >> 8);
+        if (valid) {
+            end = samples_end;
+        }
+    }
+    if (!valid) {
+        CM1106_LOG("DEBUG: Invalid block of readings!\n");
+    }
+}
+
+
+bool CM1106_Decoder::is_valid() {
+    return valid;
+}
+
+
+uint8_t CM1106_Decoder::get_count() {
+    return valid ? block[1] : 0;
+}
+
+
+/* Get next reading */
+bool CM1106_Decoder::next(CM1106_reading *reading) {
+
+    if (!valid || index >= block[1]) {
+        return false;
+    }
+
+    if (index == 0) {
+        last.timestamp = block[3] | ((uint32_t)block[4] << 8) | ((uint32_t)block[5] << 16) | ((uint32_t)block[6] << 24);
+        last.co2 = (int16_t)(block[7] | (block[8] << 8));
+        last.status = block[9];
+    } else {
+        if (pos >= end) {
+            return false;
+        }
+
+        uint8_t first = block[pos++];
+        uint32_t time, co2;
+        if ((first & CM1106_CODEC_MEDIUM) == 0) {
+            time = first >> 4;
+            co2 = first & 0x0F;
+        } else if ((first & CM1106_CODEC_TAG) == CM1106_CODEC_MEDIUM) {
+            time = first & 0x3F;
+            co2 = pos < end ? block[pos++] : 0;
+        } else {
+            time = read_varint();
+            co2 = read_varint();
+            if ((first & CM1106_CODEC_STATUS) && pos < end) {
+                last.status = block[pos++];
+            }
+        }
+
+        last_delta += cm1106_unzigzag(time);
+        last.timestamp += last_delta;
+        last.co2 += cm1106_unzigzag(co2);
+    }
+
+    index++;
+    *reading = last;
+    return true;
+}
+
+
+/* Read a varint of samples */
+uint32_t CM1106_Decoder::read_varint() {
+    uint32_t value = 0;
+    uint8_t shift = 0;
+
+    while (pos < end && shift < 35) {
+        uint8_t b = block[pos++];
+        value |= (uint32_t)(b & 0x7F) << shift;
+        shift += 7;
+        if ((b & 0x80) == 0) {
+            break;
+        }
+    }
+
+    return value;
+}
@@ -0,0 +1,104 @@
+/*
+    CM1106 Library for serial communication (UART)
+
+Copyright (c) 2021 Josep Comas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/    
+
+
+#ifndef _CM1106_CODEC
+    #define _CM1106_CODEC
+
+    #include "cm1106_uart.h"
+
+    /* Block of readings (little endian), padded with zeros to its fixed size:
+         header: version, count, length of samples, timestamp (4 bytes), co2 (2 bytes), status of first reading
+         samples from the second reading, with time as delta of delta and co2 as delta (zigzag):
+           0ttt cccc                       time in [-4, 3] ms and co2 in [-8, 7] ppm, same status
+           10tt tttt  cccc cccc            time in [-32, 31] ms and co2 in [-128, 127] ppm, same status
+           1100 000s  time co2 [status]    varints (LEB128), status follows if s is set
+         checksum: Fletcher-16 of the rest of the block
+       Timestamps are exact (ms): with a jitter up to 10 ms (e.g. a task woken up every period),
+       most readings take 1 or 2 bytes. */
+    #define CM1106_CODEC_VERSION         2   // Version of block format
+    #define CM1106_CODEC_BLOCK         128   // Default size of a block (bytes)
+    #define CM1106_CODEC_MIN_BLOCK      24   // Min size of a block
+    #define CM1106_CODEC_HEADER         10   // Length of header
+    #define CM1106_CODEC_CHECKSUM        2   // Length of checksum
+    #define CM1106_CODEC_MAX_SAMPLE     10   // Max length of an encoded sample
+    #define CM1106_CODEC_MEDIUM       0x80   // Tag of a sample of 2 bytes
+    #define CM1106_CODEC_LONG         0xC0   // First byte of a sample with varints
+    #define CM1106_CODEC_TAG          0xC0   // Mask of tag in first byte of samples of 2 bytes or more
+    #define CM1106_CODEC_STATUS       0x01   // Status follows in a sample with varints
+
+
+    /* Zigzag: small negative and positive values to small unsigned values */
+    inline uint32_t cm1106_zigzag(int32_t value) { return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31); }
+    inline int32_t cm1106_unzigzag(uint32_t value) { return (int32_t)(value >> 1) ^ -(int32_t)(value & 1); }
+
+    uint16_t cm1106_fletcher16(const uint8_t *data, size_t size);               // Checksum of a block
+
+
+    /* Encoder of readings into blocks of fixed size, in a buffer of the caller */
+    class CM1106_Encoder
+    {
+        public:
+            CM1106_Encoder(uint8_t *block, uint8_t size = CM1106_CODEC_BLOCK);  // Initialize with buffer of a block
+            bool add(const CM1106_reading &reading);                            // Append a reading, false if block is full (finish it and start another one)
+            uint8_t finish();                                                   // Write header and checksum, return size of block to send (0 if empty)
+            void reset();                                                       // Start a new block in the buffer
+            uint8_t get_count();                                                // Get number of readings in block
+
+        private:
+            uint8_t *block;                                                     // Buffer of block
+            uint8_t size;                                                       // Size of block
+            uint8_t pos;                                                        // Position of next sample
+            uint8_t count;                                                      // Readings in block
+            uint32_t last_time;                                                 // Previous reading
+            int32_t last_delta;                                                 // Time between two previous readings
+            int16_t last_co2;
+            uint8_t last_status;
+    };
+
+
+    /* Decoder of a block, reading by reading */
+    class CM1106_Decoder
+    {
+        public:
+            CM1106_Decoder(const uint8_t *block, uint8_t size = CM1106_CODEC_BLOCK);  // Initialize with a received block
+            bool is_valid();                                                    // Check header and checksum
+            uint8_t get_count();                                                // Get number of readings in block
+            bool next(CM1106_reading *reading);                                 // Get next reading, false at end of block
+
+        private:
+            const uint8_t *block;
+            uint8_t size;
+            bool valid;
+            uint8_t end;                                                        // End of samples
+            uint8_t pos;                                                        // Position of next sample
+            uint8_t index;                                                      // Readings already decoded
+            CM1106_reading last;                                                // Last decoded reading
+            int32_t last_delta;
+
+            uint32_t read_varint();                                             // Read a varint of samples
+    };
+
+#endif
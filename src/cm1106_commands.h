@@ -0,0 +1,75 @@
+/*
+    CM1106 Library for serial communication (UART)
+
+Copyright (c) 2021 Josep Comas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/    
+
+
+#ifndef _CM1106_COMMANDS
+    #define _CM1106_COMMANDS
+
+    #include "cm1106_uart.h"
+
+    /* Identifier of each descriptor (index for per command tables) */
+    #define CM1106_ID_GET_CO2                  0
+    #define CM1106_ID_START_CALIBRATION        1
+    #define CM1106_ID_GET_ABC                  2
+    #define CM1106_ID_SET_ABC                  3
+    #define CM1106_ID_GET_SOFTWARE_VERSION     4
+    #define CM1106_ID_GET_SERIAL_NUMBER        5
+    #define CM1106_ID_STORE_ABC_DATA           6
+    #define CM1106_ID_GET_MEASUREMENT_PERIOD   7
+    #define CM1106_ID_SET_MEASUREMENT_PERIOD   8
+    #define CM1106_ID_GET_WORKING_STATUS       9
+    #define CM1106_ID_SET_WORKING_STATUS      10
+
+
+    /* Descriptors of commands: name, identifier, command byte, bytes of data of request and response, timeout (ms).
+       Frame lengths and checksum of header are computed at compile time. */
+    CM1106_COMMAND(CM1106_DESC_GET_CO2,                CM1106_ID_GET_CO2,                CM1106_CMD_GET_CO2,               0,  4, CM1106_TIMEOUT_MS);
+    CM1106_COMMAND(CM1106_DESC_START_CALIBRATION,      CM1106_ID_START_CALIBRATION,      CM1106_CMD_START_CALIBRATION,     2,  0, CM1106_TIMEOUT_WRITE);
+    CM1106_COMMAND(CM1106_DESC_GET_ABC,                CM1106_ID_GET_ABC,                CM1106_CMD_GET_ABC,               0,  6, CM1106_TIMEOUT_MS);
+    CM1106_COMMAND(CM1106_DESC_SET_ABC,                CM1106_ID_SET_ABC,                CM1106_CMD_SET_ABC,               6,  0, CM1106_TIMEOUT_WRITE);
+    CM1106_COMMAND(CM1106_DESC_GET_SOFTWARE_VERSION,   CM1106_ID_GET_SOFTWARE_VERSION,   CM1106_CMD_GET_SOFTWARE_VERSION,  0, 11, CM1106_TIMEOUT_MS);
+    CM1106_COMMAND(CM1106_DESC_GET_SERIAL_NUMBER,      CM1106_ID_GET_SERIAL_NUMBER,      CM1106_CMD_GET_SERIAL_NUMBER,     0, 10, CM1106_TIMEOUT_MS);
+    CM1106_COMMAND(CM1106_DESC_STORE_ABC_DATA,         CM1106_ID_STORE_ABC_DATA,         CM1106_CMD_STORE_ABC_DATA,        0,  0, CM1106_TIMEOUT_WRITE);
+    CM1106_COMMAND(CM1106_DESC_GET_MEASUREMENT_PERIOD, CM1106_ID_GET_MEASUREMENT_PERIOD, CM1106_CMD_MEASUREMENT_PERIOD,    0,  3, CM1106_TIMEOUT_MS);
+    CM1106_COMMAND(CM1106_DESC_SET_MEASUREMENT_PERIOD, CM1106_ID_SET_MEASUREMENT_PERIOD, CM1106_CMD_MEASUREMENT_PERIOD,    3,  0, CM1106_TIMEOUT_WRITE);
+    CM1106_COMMAND(CM1106_DESC_GET_WORKING_STATUS,     CM1106_ID_GET_WORKING_STATUS,     CM1106_CMD_WORKING_STATUS,        0,  1, CM1106_TIMEOUT_MS);
+    CM1106_COMMAND(CM1106_DESC_SET_WORKING_STATUS,     CM1106_ID_SET_WORKING_STATUS,     CM1106_CMD_WORKING_STATUS,        1,  0, CM1106_TIMEOUT_WRITE);
+
+    /* Descriptors by identifier */
+    static constexpr const CM1106_command *CM1106_DESCRIPTORS[CM1106_NUM_COMMANDS] = {
+        &CM1106_DESC_GET_CO2, &CM1106_DESC_START_CALIBRATION, &CM1106_DESC_GET_ABC, &CM1106_DESC_SET_ABC,
+        &CM1106_DESC_GET_SOFTWARE_VERSION, &CM1106_DESC_GET_SERIAL_NUMBER, &CM1106_DESC_STORE_ABC_DATA,
+        &CM1106_DESC_GET_MEASUREMENT_PERIOD, &CM1106_DESC_SET_MEASUREMENT_PERIOD,
+        &CM1106_DESC_GET_WORKING_STATUS, &CM1106_DESC_SET_WORKING_STATUS
+    };
+
+    static_assert(CM1106_ID_SET_WORKING_STATUS == CM1106_NUM_COMMANDS - 1, "CM1106_NUM_COMMANDS must be the number of command descriptors");
+    static_assert(CM1106_CAPS_ALL == (1 << CM1106_NUM_COMMANDS) - 1, "CM1106_CAPS_ALL must have a bit per command descriptor");
+
+    // Requests without data are sent as precomputed frames, e.g. GET_CO2 is always 11 01 01 ED
+    static_assert(CM1106_DESC_GET_CO2.frame[0] == 0x11 && CM1106_DESC_GET_CO2.frame[1] == 0x01 &&
+                  CM1106_DESC_GET_CO2.frame[2] == 0x01 && CM1106_DESC_GET_CO2.frame[3] == 0xED, "Invalid GET_CO2 frame");
+
+#endif
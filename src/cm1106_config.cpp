@@ -0,0 +1,161 @@
+/*
+    CM1106 Library for serial communication (UART)
+
+Copyright (c) 2021 Josep Comas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include "cm1106_config.h"
+
+
+/* Initialize without settings */
+CM1106_Config::CM1106_Config()
+{
+    clear();
+}
+
+
+/* Desired ABC parameters */
+void CM1106_Config::set_ABC(uint8_t open_close, uint8_t cycle, int16_t base) {
+    abc.open_close = open_close;
+    abc.cycle = cycle;
+    abc.base = base;
+    items |= CM1106_CONFIG_ABC;
+}
+
+
+/* Desired measurement period and number of smoothed data */
+void CM1106_Config::set_measurement_period(int16_t period, uint8_t smoothed) {
+    this->period = period;
+    this->smoothed = smoothed;
+    items |= CM1106_CONFIG_PERIOD;
+}
+
+
+/* Desired working status */
+void CM1106_Config::set_working_status(uint8_t mode) {
+    this->mode = mode;
+    items |= CM1106_CONFIG_STATUS;
+}
+
+
+/* Remove all settings */
+void CM1106_Config::clear() {
+    items = 0;
+    abc.open_close = 0;
+    abc.cycle = 0;
+    abc.base = 0;
+    period = 0;
+    smoothed = 0;
+    mode = 0;
+    written = 0;
+    failed = 0;
+}
+
+
+uint8_t CM1106_Config::get_items() {
+    return items;
+}
+
+
+/* Read, write settings that differ and verify them */
+bool CM1106_Config::apply(CM1106_Protocol &sensor) {
+    written = 0;
+    failed = 0;
+
+    // Read current settings
+    uint8_t differ = compare(sensor, items);
+
+    // Write only settings that differ
+    if (differ & CM1106_CONFIG_ABC) {
+        if (sensor.set_ABC(abc.open_close, abc.cycle, abc.base)) {
+            written |= CM1106_CONFIG_ABC;
+        } else {
+            failed |= CM1106_CONFIG_ABC;
+        }
+    }
+    if (differ & CM1106_CONFIG_PERIOD) {
+        if (sensor.set_measurement_period(period, smoothed)) {
+            written |= CM1106_CONFIG_PERIOD;
+        } else {
+            failed |= CM1106_CONFIG_PERIOD;
+        }
+    }
+    if (differ & CM1106_CONFIG_STATUS) {
+        if (sensor.set_working_status(mode)) {
+            written |= CM1106_CONFIG_STATUS;
+        } else {
+            failed |= CM1106_CONFIG_STATUS;
+        }
+    }
+
+    // Verify written settings: setters invalidate the cache, so they are read from the sensor
+    failed |= compare(sensor, written);
+
+    CM1106_LOG("DEBUG: Config applied, written 0x%02x, failed 0x%02x\n", written, failed);
+
+    return failed == 0;
+}
+
+
+uint8_t CM1106_Config::get_written() {
+    return written;
+}
+
+
+uint8_t CM1106_Config::get_failed() {
+    return failed;
+}
+
+
+/* Read settings, return the ones that differ */
+uint8_t CM1106_Config::compare(CM1106_Protocol &sensor, uint8_t check) {
+    uint8_t differ = 0;
+
+    if (check & CM1106_CONFIG_ABC) {
+        CM1106_ABC current;
+        if (!sensor.get_ABC(&current)) {
+            failed |= CM1106_CONFIG_ABC;
+        } else if (current.open_close != abc.open_close || current.cycle != abc.cycle || current.base != abc.base) {
+            differ |= CM1106_CONFIG_ABC;
+        }
+    }
+    if (check & CM1106_CONFIG_PERIOD) {
+        int16_t current_period;
+        uint8_t current_smoothed;
+        if (!sensor.get_measurement_period(&current_period, &current_smoothed)) {
+            failed |= CM1106_CONFIG_PERIOD;
+        } else if (current_period != period || current_smoothed != smoothed) {
+            differ |= CM1106_CONFIG_PERIOD;
+        }
+    }
+    if (check & CM1106_CONFIG_STATUS) {
+        uint8_t current_mode;
+        if (!sensor.get_working_status(&current_mode)) {
+            failed |= CM1106_CONFIG_STATUS;
+        } else if (current_mode != mode) {
+            differ |= CM1106_CONFIG_STATUS;
+        }
+    }
+
+    return differ;
+}
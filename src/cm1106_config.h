@@ -0,0 +1,66 @@
+/*
+    CM1106 Library for serial communication (UART)
+
+Copyright (c) 2021 Josep Comas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/    
+
+
+#ifndef _CM1106_CONFIG
+    #define _CM1106_CONFIG
+
+    #include "cm1106_uart.h"
+
+    /* Settings of desired state */
+    #define CM1106_CONFIG_ABC           0x01   // ABC parameters
+    #define CM1106_CONFIG_PERIOD        0x02   // Measurement period and number of smoothed data (CM1106SL-N)
+    #define CM1106_CONFIG_STATUS        0x04   // Working status (CM1106SL-N)
+
+
+    /* Desired settings of a sensor. apply() reads the current settings, writes only the ones that
+       differ and reads them back, so a boot with an already configured sensor costs only reads
+       and does not rewrite its non-volatile storage. */
+    class CM1106_Config
+    {
+        public:
+            CM1106_Config();                                                    // Initialize without settings
+            void set_ABC(uint8_t open_close, uint8_t cycle, int16_t base);      // Desired ABC parameters
+            void set_measurement_period(int16_t period, uint8_t smoothed);      // Desired measurement period and number of smoothed data
+            void set_working_status(uint8_t mode);                              // Desired working status
+            void clear();                                                       // Remove all settings
+            uint8_t get_items();                                                // Get settings of desired state (CM1106_CONFIG_xxx)
+            bool apply(CM1106_Protocol &sensor);                                // Read, write settings that differ and verify them, true if sensor matches
+            uint8_t get_written();                                              // Get settings written by last apply (CM1106_CONFIG_xxx)
+            uint8_t get_failed();                                               // Get settings not read, written or verified by last apply (CM1106_CONFIG_xxx)
+
+        private:
+            uint8_t items;                                                      // Settings of desired state (CM1106_CONFIG_xxx)
+            CM1106_ABC abc;
+            int16_t period;
+            uint8_t smoothed;
+            uint8_t mode;
+            uint8_t written;                                                    // Result of last apply
+            uint8_t failed;
+
+            uint8_t compare(CM1106_Protocol &sensor, uint8_t check);            // Read settings, return the ones that differ (failed if not read)
+    };
+
+#endif
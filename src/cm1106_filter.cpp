@@ -0,0 +1,136 @@
+/*
+    CM1106 Library for serial communication (UART)
+
+Copyright (c) 2021 Josep Comas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include "cm1106_filter.h"
+
+// Values of 16 bits and their fixed point state fit in 32 bits, rounding needs a fractional bit
+static_assert(CM1106_FILTER_FRAC >= 1 && CM1106_FILTER_FRAC <= 15, "Invalid fractional bits of filters");
+
+
+/* Initialize */
+CM1106_Filter::CM1106_Filter()
+{
+    next = NULL;
+}
+
+
+/* Append a stage after this one */
+CM1106_Filter &CM1106_Filter::then(CM1106_Filter &next) {
+    this->next = &next;
+    return next;
+}
+
+
+/* Filter a reading through this stage and following ones */
+void CM1106_Filter::process(CM1106_reading *reading) {
+
+    for (CM1106_Filter *stage = this; stage != NULL && reading->status == CM1106_READING_OK; stage = stage->next) {
+        stage->filter(reading);
+    }
+}
+
+
+/* Forget past readings of this stage and following ones */
+void CM1106_Filter::reset() {
+    for (CM1106_Filter *stage = this; stage != NULL; stage = stage->next) {
+        stage->clear();
+    }
+}
+
+
+/* Initialize with smoothing factor 1/2^shift */
+CM1106_EMA::CM1106_EMA(uint8_t shift)
+{
+    if (shift > CM1106_FILTER_FRAC) {
+        CM1106_LOG("DEBUG: EMA shift %d too large, limited to %d\n", shift, CM1106_FILTER_FRAC);
+        shift = CM1106_FILTER_FRAC;
+    }
+    this->shift = shift;
+    clear();
+}
+
+
+void CM1106_EMA::filter(CM1106_reading *reading) {
+    int32_t value = (int32_t)reading->co2 << CM1106_FILTER_FRAC;
+
+    if (!started) {
+        state = value;
+        started = true;
+    } else {
+        state += (value - state) >> shift;
+    }
+
+    reading->co2 = (state + (1 << (CM1106_FILTER_FRAC - 1))) >> CM1106_FILTER_FRAC;
+}
+
+
+void CM1106_EMA::clear() {
+    state = 0;
+    started = false;
+}
+
+
+/* Initialize */
+CM1106_OutlierGate::CM1106_OutlierGate(uint16_t max_step, uint16_t max_rate)
+{
+    this->max_step = max_step;
+    this->max_rate = max_rate;
+    clear();
+}
+
+
+void CM1106_OutlierGate::filter(CM1106_reading *reading) {
+
+    if (started) {
+        // Elapsed seconds limited to keep product in 32 bits
+        uint32_t elapsed_s = (reading->timestamp - last_time) / 1000;
+        if (elapsed_s > UINT16_MAX) {
+            elapsed_s = UINT16_MAX;
+        }
+        uint32_t allowed = max_step + (uint32_t)max_rate * elapsed_s / 60;
+        int32_t change = (int32_t)reading->co2 - last;
+        uint32_t magnitude = (change < 0) ? -change : change;
+
+        if (magnitude > allowed && rejects < CM1106_FILTER_MAX_REJECTS) {
+            reading->status = CM1106_READING_REJECTED;
+            rejects++;
+            return;
+        }
+    }
+
+    last = reading->co2;
+    last_time = reading->timestamp;
+    rejects = 0;
+    started = true;
+}
+
+
+void CM1106_OutlierGate::clear() {
+    last = 0;
+    last_time = 0;
+    rejects = 0;
+    started = false;
+}
@@ -0,0 +1,174 @@
+/*
+    CM1106 Library for serial communication (UART)
+
+Copyright (c) 2021 Josep Comas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/    
+
+
+#ifndef _CM1106_FILTER
+    #define _CM1106_FILTER
+
+    #include "cm1106_uart.h"
+
+    #define CM1106_FILTER_FRAC           8   // Fractional bits of fixed point state (EMA)
+    #define CM1106_FILTER_MAX_REJECTS    3   // Consecutive outliers accepted as a real step of CO2
+    #define CM1106_MEDIAN_MAX_WINDOW    32   // Max window of median filter (each reading moves up to W values)
+
+
+    /* Stage of a filter chain on readings, without heap or floating point. Only readings with status
+       CM1106_READING_OK are filtered: invalid readings go through the chain unchanged and do not
+       update the state of any stage. */
+    class CM1106_Filter
+    {
+        public:
+            CM1106_Filter();                                                    // Initialize
+            virtual ~CM1106_Filter() {}
+            CM1106_Filter &then(CM1106_Filter &next);                           // Append a stage after this one, return it to chain calls
+            void process(CM1106_reading *reading);                              // Filter a reading through this stage and following ones
+            void reset();                                                       // Forget past readings of this stage and following ones
+
+        protected:
+            virtual void filter(CM1106_reading *reading) = 0;                   // Filter a valid reading in place
+            virtual void clear() = 0;                                           // Forget past readings
+
+        private:
+            CM1106_Filter *next;                                                // Following stage
+    };
+
+
+    /* Median of last W valid readings: binary search of sorted window, O(log W) comparisons
+       and a move of the values between the old and the new position, O(W) in the worst case.
+       For windows up to CM1106_MEDIAN_MAX_WINDOW, this move of at most 64 bytes costs less than
+       the pointers of an indexable structure (e.g. skip list), in memory and in time. */
+    template <uint8_t W>
+    class CM1106_Median : public CM1106_Filter
+    {
+        static_assert(W > 0, "Empty window of median filter");
+        static_assert(W <= CM1106_MEDIAN_MAX_WINDOW, "Window of median filter too large");
+
+        public:
+            CM1106_Median() {
+                clear();
+            }
+
+        protected:
+            void filter(CM1106_reading *reading) override {
+                int16_t value = reading->co2;
+
+                if (nb < W) {
+                    // Window filling
+                    window[(head + nb) % W] = value;
+                    uint8_t pos = upper_bound(0, nb, value);
+                    memmove(&sorted[pos + 1], &sorted[pos], (nb - pos) * sizeof(int16_t));
+                    sorted[pos] = value;
+                    nb++;
+                } else {
+                    // Replace oldest value
+                    int16_t old = window[head];
+                    window[head] = value;
+                    head = (head + 1) % W;
+
+                    uint8_t out = upper_bound(0, W, old) - 1;
+                    if (value >= old) {
+                        uint8_t pos = upper_bound(out + 1, W, value);
+                        memmove(&sorted[out], &sorted[out + 1], (pos - 1 - out) * sizeof(int16_t));
+                        sorted[pos - 1] = value;
+                    } else {
+                        uint8_t pos = upper_bound(0, out, value);
+                        memmove(&sorted[pos + 1], &sorted[pos], (out - pos) * sizeof(int16_t));
+                        sorted[pos] = value;
+                    }
+                }
+
+                if (nb & 1) {
+                    reading->co2 = sorted[nb / 2];
+                } else {
+                    reading->co2 = (sorted[nb / 2 - 1] + sorted[nb / 2] + 1) / 2;
+                }
+            }
+
+            void clear() override {
+                nb = 0;
+                head = 0;
+            }
+
+        private:
+            int16_t window[W];                                                  // Last values in order of arrival
+            int16_t sorted[W];                                                  // Last values sorted
+            uint8_t nb;                                                         // Values in window
+            uint8_t head;                                                       // Position of oldest value
+
+            /* First position in [first, last) of sorted with a value greater than given one */
+            uint8_t upper_bound(uint8_t first, uint8_t last, int16_t value) {
+                while (first < last) {
+                    uint8_t mid = first + (last - first) / 2;
+                    if (sorted[mid] <= value) {
+                        first = mid + 1;
+                    } else {
+                        last = mid;
+                    }
+                }
+                return first;
+            }
+    };
+
+
+    /* Exponential moving average with factor 1/2^shift, state in fixed point (CM1106_FILTER_FRAC bits).
+       shift is limited to CM1106_FILTER_FRAC: with a larger one, a change of 1 ppm would not move the state. */
+    class CM1106_EMA : public CM1106_Filter
+    {
+        public:
+            CM1106_EMA(uint8_t shift);                                          // Initialize with smoothing factor 1/2^shift (shift <= CM1106_FILTER_FRAC)
+
+        protected:
+            void filter(CM1106_reading *reading) override;
+            void clear() override;
+
+        private:
+            uint8_t shift;
+            int32_t state;                                                      // Average (fixed point)
+            bool started;                                                       // Average has a value
+    };
+
+
+    /* Reject readings changing faster than max_step ppm plus max_rate ppm per minute since last
+       accepted reading: they are marked CM1106_READING_REJECTED. After CM1106_FILTER_MAX_REJECTS
+       consecutive rejections, the new level is accepted. */
+    class CM1106_OutlierGate : public CM1106_Filter
+    {
+        public:
+            CM1106_OutlierGate(uint16_t max_step, uint16_t max_rate);          // Initialize
+
+        protected:
+            void filter(CM1106_reading *reading) override;
+            void clear() override;
+
+        private:
+            uint16_t max_step;                                                  // Change allowed at once (ppm)
+            uint16_t max_rate;                                                  // Change allowed per minute (ppm)
+            int16_t last;                                                       // Last accepted value
+            uint32_t last_time;                                                 // Timestamp (ms) of last accepted value
+            uint8_t rejects;                                                    // Consecutive rejected readings
+            bool started;                                                       // A value was accepted
+    };
+
+#endif
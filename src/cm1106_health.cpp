@@ -0,0 +1,205 @@
+/*
+    CM1106 Library for serial communication (UART)
+
+Copyright (c) 2021 Josep Comas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include "cm1106_health.h"
+
+
+/* Initialize */
+CM1106_Health::CM1106_Health(CM1106_Protocol &sensor)
+{
+    this->sensor = &sensor;
+    config = NULL;
+    callback = NULL;
+    state = CM1106_HEALTH_HEALTHY;
+    failures = 0;
+    successes = 0;
+    next_probe = 0;
+    probe_interval = CM1106_HEALTH_PROBE_MIN;
+    probes = 0;
+    recoveries = 0;
+}
+
+
+/* Set function called on each change of state */
+void CM1106_Health::set_callback(void (*callback)(CM1106_Health &health, uint8_t previous)) {
+    this->callback = callback;
+}
+
+
+/* Set configuration applied on recovery */
+void CM1106_Health::set_config(CM1106_Config *config) {
+    this->config = config;
+}
+
+
+/* Read CO2 if sensor is not lost */
+bool CM1106_Health::get_co2(CM1106_reading *reading) {
+    bool ok = false;
+
+    if (reading == NULL) {
+        return false;
+    }
+
+    reading->timestamp = cm1106_millis();
+    reading->co2 = 0;
+    reading->status = CM1106_READING_ERROR;
+
+    if (!check()) {
+        return false;
+    }
+
+    int16_t co2;
+    ok = sensor->get_co2(&co2);
+    if (ok) {
+        reading->co2 = co2;
+        reading->status = CM1106_READING_OK;
+    }
+    report(ok);
+
+    return ok;
+}
+
+
+/* Probe lost sensor when due */
+bool CM1106_Health::check() {
+
+    if (state != CM1106_HEALTH_LOST) {
+        return true;
+    }
+
+    if (!is_due()) {
+        return false;
+    }
+
+    return probed(sensor->probe() != CM1106_MODEL_NONE);
+}
+
+
+/* Check if sensor can be read now or its probe is due, without probing */
+bool CM1106_Health::is_due() {
+    return state != CM1106_HEALTH_LOST || (int32_t)(cm1106_millis() - next_probe) >= 0;
+}
+
+
+/* Count result of a probe of lost sensor, true if it answered */
+bool CM1106_Health::probed(bool answered) {
+
+    probes++;
+    if (!answered) {
+        // Probe less often while the sensor stays away
+        probe_interval = probe_interval < CM1106_HEALTH_PROBE_MAX / 2 ? probe_interval * 2 : CM1106_HEALTH_PROBE_MAX;
+        next_probe = cm1106_millis() + probe_interval;
+        return false;
+    }
+
+    // Sensor may have been reset or replaced: metadata read again, configuration applied
+    recoveries++;
+    failures = 0;
+    successes = 0;
+    sensor->invalidate_cache();
+    change(CM1106_HEALTH_RECOVERING);
+    if (config != NULL && !config->apply(*sensor)) {
+        CM1106_LOG("DEBUG: Configuration not applied on recovery, failed 0x%02x\n", config->get_failed());
+    }
+
+    return true;
+}
+
+
+/* Count result of a reading done by the caller */
+void CM1106_Health::report(bool ok) {
+
+    // Reading of lost sensor when its probe is due is the probe, other ones are not counted
+    if (state == CM1106_HEALTH_LOST && (!is_due() || !probed(ok))) {
+        return;
+    }
+
+    if (ok) {
+        failures = 0;
+        if (state == CM1106_HEALTH_DEGRADED) {
+            change(CM1106_HEALTH_HEALTHY);
+        } else if (state == CM1106_HEALTH_RECOVERING && ++successes >= CM1106_HEALTH_RECOVERED) {
+            change(CM1106_HEALTH_HEALTHY);
+        }
+        return;
+    }
+
+    if (failures < 255) {
+        failures++;
+    }
+
+    if (failures >= CM1106_HEALTH_LOST_FAILURES || state == CM1106_HEALTH_RECOVERING) {
+        probe_interval = CM1106_HEALTH_PROBE_MIN;
+        next_probe = cm1106_millis() + probe_interval;
+        change(CM1106_HEALTH_LOST);
+    } else if (state == CM1106_HEALTH_HEALTHY) {
+        // Bytes of a late response or of a desynchronized line must not be taken for the next one
+        sensor->flush();
+        change(CM1106_HEALTH_DEGRADED);
+    }
+}
+
+
+uint8_t CM1106_Health::get_state() {
+    return state;
+}
+
+
+uint32_t CM1106_Health::get_next_probe() {
+    return next_probe;
+}
+
+
+uint32_t CM1106_Health::get_probes() {
+    return probes;
+}
+
+
+uint32_t CM1106_Health::get_recoveries() {
+    return recoveries;
+}
+
+
+CM1106_Protocol &CM1106_Health::get_sensor() {
+    return *sensor;
+}
+
+
+/* Change state and call callback */
+void CM1106_Health::change(uint8_t state) {
+    uint8_t previous = this->state;
+
+    if (state == previous) {
+        return;
+    }
+
+    this->state = state;
+    CM1106_LOG("DEBUG: Health %d -> %d\n", previous, state);
+
+    if (callback != NULL) {
+        callback(*this, previous);
+    }
+}
@@ -0,0 +1,80 @@
+/*
+    CM1106 Library for serial communication (UART)
+
+Copyright (c) 2021 Josep Comas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/    
+
+
+#ifndef _CM1106_HEALTH
+    #define _CM1106_HEALTH
+
+    #include "cm1106_uart.h"
+    #include "cm1106_config.h"
+
+    #define CM1106_HEALTH_LOST_FAILURES      3   // Consecutive failures to consider the sensor lost
+    #define CM1106_HEALTH_RECOVERED          3   // Consecutive valid readings after recovery to consider the sensor healthy
+    #define CM1106_HEALTH_PROBE_MIN       1000   // First interval (ms) between probes of a lost sensor
+    #define CM1106_HEALTH_PROBE_MAX     300000   // Max interval (ms) between probes, doubled after each failed probe
+
+    /* States of health */
+    #define CM1106_HEALTH_HEALTHY            0   // Readings valid
+    #define CM1106_HEALTH_DEGRADED           1   // Last readings failed, stale received bytes flushed
+    #define CM1106_HEALTH_LOST               2   // Not answering, only probed from time to time
+    #define CM1106_HEALTH_RECOVERING         3   // Answering again, configuration applied, waiting valid readings
+
+
+    /* Health of a sensor driven by consecutive failures: healthy -> degraded -> lost -> recovering -> healthy.
+       While lost, no request is sent except a probe (a few tens of ms) at growing intervals, so a dead
+       sensor costs almost nothing; when it answers again, its configuration is applied before reading. */
+    class CM1106_Health
+    {
+        public:
+            CM1106_Health(CM1106_Protocol &sensor);                             // Initialize (healthy)
+            void set_callback(void (*callback)(CM1106_Health &health, uint8_t previous));  // Set function called on each change of state
+            void set_config(CM1106_Config *config);                             // Set configuration applied on recovery (NULL = none)
+            bool get_co2(CM1106_reading *reading);                              // Read CO2 if sensor is not lost, false on error or if not read
+            bool check();                                                       // Probe lost sensor when due, true if sensor can be read now
+            bool is_due();                                                      // Check if sensor can be read now or its probe is due, without probing
+            void report(bool ok);                                               // Count result of a reading done by the caller (probe if sensor is lost)
+            uint8_t get_state();                                                // Get state of health (CM1106_HEALTH_xxx)
+            uint32_t get_next_probe();                                          // Get time (ms, as cm1106_millis()) of next probe of lost sensor
+            uint32_t get_probes();                                              // Get number of probes of lost sensor
+            uint32_t get_recoveries();                                          // Get number of recoveries of lost sensor
+            CM1106_Protocol &get_sensor();                                      // Get sensor
+
+        private:
+            CM1106_Protocol *sensor;                                            // Watched sensor
+            CM1106_Config *config;                                              // Configuration applied on recovery
+            void (*callback)(CM1106_Health &health, uint8_t previous);
+            uint8_t state;                                                      // State of health (CM1106_HEALTH_xxx)
+            uint8_t failures;                                                   // Consecutive failures
+            uint8_t successes;                                                  // Consecutive valid readings while recovering
+            uint32_t next_probe;                                                // Time (ms) of next probe
+            uint32_t probe_interval;                                            // Interval (ms) between probes
+            uint32_t probes;
+            uint32_t recoveries;
+
+            bool probed(bool answered);                                         // Count result of a probe of lost sensor, true if it answered
+            void change(uint8_t state);                                         // Change state and call callback
+    };
+
+#endif
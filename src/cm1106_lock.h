@@ -0,0 +1,74 @@
+/*
+    CM1106 Library for serial communication (UART)
+
+Copyright (c) 2021 Josep Comas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/    
+
+
+#ifndef _CM1106_LOCK
+    #define _CM1106_LOCK
+
+    #if defined ARDUINO_ARCH_ESP32
+        #include <freertos/FreeRTOS.h>
+        #include <freertos/semphr.h>
+    #elif defined CM1106_NATIVE
+        #include <mutex>
+    #endif
+
+
+    /* Recursive mutex to serialize transactions of several tasks with the same sensor
+       (FreeRTOS on ESP32, std::recursive_mutex on native builds, nothing on single task platforms) */
+    class CM1106_Lock
+    {
+        public:
+#if defined ARDUINO_ARCH_ESP32
+            CM1106_Lock() { mutex = xSemaphoreCreateRecursiveMutex(); }
+            void lock() { xSemaphoreTakeRecursive(mutex, portMAX_DELAY); }
+            void unlock() { xSemaphoreGiveRecursive(mutex); }
+
+        private:
+            SemaphoreHandle_t mutex;
+#elif defined CM1106_NATIVE
+            void lock() { mutex.lock(); }
+            void unlock() { mutex.unlock(); }
+
+        private:
+            std::recursive_mutex mutex;
+#else
+            void lock() {}
+            void unlock() {}
+#endif
+    };
+
+
+    /* Hold a lock until end of scope */
+    class CM1106_Guard
+    {
+        public:
+            CM1106_Guard(CM1106_Lock &lock) : lock(lock) { lock.lock(); }
+            ~CM1106_Guard() { lock.unlock(); }
+
+        private:
+            CM1106_Lock &lock;
+    };
+
+#endif
@@ -0,0 +1,172 @@
+/*
+    CM1106 Library for serial communication (UART)
+
+Copyright (c) 2021 Josep Comas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include "cm1106_uart.h"
+
+#if (CM1106_LOG_LEVEL > CM1106_LOG_LEVEL_NONE) && defined(CM1106_LOG_DEFERRED)
+
+#define CM1106_LOG_MARK   "CM1106LOG "   // Prefix of dumped lines
+
+#if CM1106_LOG_MAX_RECORD > CM1106_LOG_LEN_MASK
+    #error "CM1106_LOG_MAX_RECORD must fit in CM1106_LOG_LEN_MASK"
+#endif
+
+
+/* Ring buffer of records, oldest records are overwritten */
+static uint8_t log_ring[CM1106_LOG_RING_SIZE];
+static uint16_t log_head = 0;                   // Position of oldest record
+static uint16_t log_count = 0;                  // Bytes stored
+static uint32_t log_dropped = 0;                // Records overwritten
+
+static CM1106_Lock &log_lock() {
+    static CM1106_Lock lock;
+    return lock;
+}
+
+
+/* Start a record */
+CM1106_LogRecord::CM1106_LogRecord(uint32_t id)
+{
+    len = 1;
+    truncated = false;
+    put(cm1106_micros());
+    put(id);
+}
+
+
+void CM1106_LogRecord::add(int value) {
+    add_int(CM1106_LOG_ARG_INT, value);
+}
+
+
+void CM1106_LogRecord::add(unsigned value) {
+    add_int(CM1106_LOG_ARG_UINT, value);
+}
+
+
+void CM1106_LogRecord::add(long value) {
+    add_int(CM1106_LOG_ARG_INT, value);
+}
+
+
+void CM1106_LogRecord::add(unsigned long value) {
+    add_int(CM1106_LOG_ARG_UINT, value);
+}
+
+
+void CM1106_LogRecord::add(const char *value) {
+    add_bytes(CM1106_LOG_ARG_STRING, (const uint8_t*)value, value != NULL ? strnlen(value, CM1106_LOG_MAX_STRING) : 0);
+}
+
+
+void CM1106_LogRecord::add(const CM1106_LogBuffer &value) {
+    add_bytes(CM1106_LOG_ARG_BUFFER, value.data, value.size < CM1106_LOG_MAX_STRING ? value.size : CM1106_LOG_MAX_STRING);
+}
+
+
+/* Add tagged 4 bytes value */
+void CM1106_LogRecord::add_int(uint8_t tag, uint32_t value) {
+
+    // Once an argument is left out, following ones are too: stored ones match the start of the format
+    if (truncated || len + 5 > CM1106_LOG_MAX_RECORD) {
+        truncated = true;
+        return;
+    }
+
+    data[len++] = tag;
+    put(value);
+}
+
+
+/* Add 4 bytes value (little endian) */
+void CM1106_LogRecord::put(uint32_t value) {
+    for (uint8_t i = 0; i < 4; i++) {
+        data[len++] = value >> (8 * i);
+    }
+}
+
+
+/* Add tagged bytes */
+void CM1106_LogRecord::add_bytes(uint8_t tag, const uint8_t *bytes, uint8_t size) {
+
+    if (truncated || len + 2 + size > CM1106_LOG_MAX_RECORD) {
+        truncated = true;
+        return;
+    }
+
+    data[len++] = tag;
+    data[len++] = size;
+    memcpy(&data[len], bytes, size);
+    len += size;
+}
+
+
+/* Store record in ring buffer */
+void CM1106_LogRecord::commit() {
+    CM1106_Guard guard(log_lock());
+
+    data[0] = len | (truncated ? CM1106_LOG_TRUNCATED : 0);
+
+    // Overwrite oldest records
+    while (CM1106_LOG_RING_SIZE - log_count < len) {
+        uint8_t oldest = log_ring[log_head] & CM1106_LOG_LEN_MASK;
+        log_head = (log_head + oldest) % CM1106_LOG_RING_SIZE;
+        log_count -= oldest;
+        log_dropped++;
+    }
+
+    uint16_t pos = (log_head + log_count) % CM1106_LOG_RING_SIZE;
+    for (uint8_t i = 0; i < len; i++) {
+        log_ring[pos] = data[i];
+        pos = (pos + 1) % CM1106_LOG_RING_SIZE;
+    }
+    log_count += len;
+}
+
+
+/* Print stored records as hex lines and clear them */
+void cm1106_log_dump(Print &out) {
+    CM1106_Guard guard(log_lock());
+
+    while (log_count > 0) {
+        uint8_t len = log_ring[log_head] & CM1106_LOG_LEN_MASK;
+        out.printf(CM1106_LOG_MARK);
+        for (uint8_t i = 0; i < len; i++) {
+            out.printf("%02x", log_ring[(log_head + i) % CM1106_LOG_RING_SIZE]);
+        }
+        out.printf("\n");
+        log_head = (log_head + len) % CM1106_LOG_RING_SIZE;
+        log_count -= len;
+    }
+}
+
+
+/* Get number of records overwritten before being dumped */
+uint32_t cm1106_log_dropped() {
+    return log_dropped;
+}
+
+#endif
@@ -0,0 +1,107 @@
+/*
+    CM1106 Library for serial communication (UART)
+
+Copyright (c) 2021 Josep Comas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/    
+
+
+#ifndef _CM1106_LOG
+    #define _CM1106_LOG
+
+    #include "Arduino.h"
+    #include "cm1106_lock.h"
+
+    #define CM1106_LOG_RING_SIZE   1024   // Bytes of RAM ring buffer of deferred log
+    #define CM1106_LOG_MAX_RECORD    64   // Max bytes of a record (up to CM1106_LOG_LEN_MASK)
+    #define CM1106_LOG_MAX_STRING    20   // Max bytes stored of string and buffer arguments
+
+    #define CM1106_LOG_LEN_MASK    0x7f   // Length of a record in its first byte
+    #define CM1106_LOG_TRUNCATED   0x80   // Flag of first byte: arguments left out, record was full
+
+    #define CM1106_LOG_ARG_INT      'i'   // Signed integer argument (4 bytes, long of 64 bits truncated to 32)
+    #define CM1106_LOG_ARG_UINT     'u'   // Unsigned integer argument (4 bytes, long of 64 bits truncated to 32)
+    #define CM1106_LOG_ARG_STRING   's'   // String argument (length + characters)
+    #define CM1106_LOG_ARG_BUFFER   'b'   // Buffer argument shown as hex bytes (length + bytes)
+
+
+    /* Identifier of a format string (FNV-1a hash computed at compile time, also computed by
+       extras/tools/cm1106_log_decode.py from the sources) */
+    constexpr uint32_t cm1106_log_hash(const char *format, uint32_t hash = 2166136261u) {
+        return *format ? cm1106_log_hash(format + 1, (hash ^ (uint8_t)*format) * 16777619u) : hash;
+    }
+
+
+    /* Bytes logged as hex */
+    struct CM1106_LogBuffer {
+        CM1106_LogBuffer(const uint8_t *data, uint8_t size) : data(data), size(size) {}
+        const uint8_t *data;
+        uint8_t size;
+    };
+
+
+    /* Binary record: length (and truncated flag), timestamp (us), format identifier and tagged arguments.
+       Integer arguments are stored in 32 bits. */
+    class CM1106_LogRecord
+    {
+        public:
+            CM1106_LogRecord(uint32_t id);                                      // Start a record
+            void add(int value);                                                // Add arguments
+            void add(unsigned value);
+            void add(long value);
+            void add(unsigned long value);
+            void add(const char *value);
+            void add(const CM1106_LogBuffer &value);
+            void commit();                                                      // Store record in ring buffer
+
+        private:
+            uint8_t data[CM1106_LOG_MAX_RECORD];
+            uint8_t len;
+            bool truncated;                                                     // Arguments left out
+
+            void add_int(uint8_t tag, uint32_t value);                          // Add tagged 4 bytes value
+            void put(uint32_t value);                                           // Add 4 bytes value
+            void add_bytes(uint8_t tag, const uint8_t *bytes, uint8_t size);    // Add tagged bytes
+    };
+
+
+    inline void cm1106_log_args(CM1106_LogRecord &record) {
+        (void)record;
+    }
+
+    template<typename T, typename... Args>
+    inline void cm1106_log_args(CM1106_LogRecord &record, T value, Args... args) {
+        record.add(value);
+        cm1106_log_args(record, args...);
+    }
+
+    /* Store a record of the format identified by id with its arguments (no formatting) */
+    template<uint32_t id, typename... Args>
+    inline void cm1106_log(Args... args) {
+        CM1106_LogRecord record(id);
+        cm1106_log_args(record, args...);
+        record.commit();
+    }
+
+    void cm1106_log_dump(Print &out);                                          // Print stored records as hex lines and clear them
+    uint32_t cm1106_log_dropped();                                              // Get number of records overwritten before being dumped
+
+#endif
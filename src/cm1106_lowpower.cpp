@@ -0,0 +1,229 @@
+/*
+    CM1106 Library for serial communication (UART)
+
+Copyright (c) 2021 Josep Comas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include "cm1106_lowpower.h"
+
+
+/* Initialize */
+CM1106_LowPower::CM1106_LowPower(CM1106_Protocol &sensor, uint32_t period_ms)
+{
+    this->sensor = &sensor;
+    trigger = NULL;
+    measure_ms = CM1106_LP_MEASURE_TIME;
+    this->period_ms = period_ms;
+    clamp_period();
+    state = CM1106_LP_IDLE;
+    cycle_start = 0;
+    trigger_time = 0;
+    next_wake = 0;
+    has_reading = false;
+    reading.timestamp = 0;
+    reading.co2 = 0;
+    reading.status = CM1106_READING_ERROR;
+    awake_us = 0;
+    missed = 0;
+}
+
+
+/* Set function driving power/enable of the sensor */
+void CM1106_LowPower::set_trigger(void (*trigger)(bool enable)) {
+    this->trigger = trigger;
+}
+
+
+/* Set time from trigger to valid measurement */
+void CM1106_LowPower::set_measure_time(uint32_t measure_ms) {
+    this->measure_ms = measure_ms;
+    clamp_period();
+}
+
+
+/* Set single measurement mode, first measurement starts now */
+bool CM1106_LowPower::begin() {
+    uint8_t mode;
+
+    // Sensor must be enabled to answer
+    enable(true);
+    bool ok = sensor->get_working_status(&mode);
+    if (ok && mode != CM1106_SINGLE_MEASUREMENT) {
+        ok = sensor->set_working_status(CM1106_SINGLE_MEASUREMENT);
+    }
+    enable(false);
+
+    if (!ok) {
+        CM1106_LOG("DEBUG: Single measurement mode not set!\n");
+        state = CM1106_LP_IDLE;
+        return false;
+    }
+
+    state = CM1106_LP_SLEEP;
+    next_wake = cm1106_millis();
+    cycle_start = next_wake;
+    return true;
+}
+
+
+/* Back to continuous measurement mode, sensor left enabled */
+bool CM1106_LowPower::end() {
+    state = CM1106_LP_IDLE;
+    enable(true);
+    return sensor->set_working_status(CM1106_CONTINUOUS_MEASUREMENT);
+}
+
+
+/* Do step due at current time */
+bool CM1106_LowPower::run() {
+    unsigned long start_us = cm1106_micros();
+    uint32_t now = cm1106_millis();
+    bool new_reading = false;
+
+    if (state == CM1106_LP_IDLE || (int32_t)(now - next_wake) < 0) {
+        return false;
+    }
+
+    switch (state) {
+        case CM1106_LP_SLEEP:
+            // Trigger measurement, sleep while sensor measures (1 ms more as milliseconds are truncated)
+            enable(true);
+            cycle_start = next_wake;
+            trigger_time = now;
+            next_wake = now + measure_ms + 1;
+            state = CM1106_LP_MEASURE;
+            break;
+
+        case CM1106_LP_MEASURE:
+            // Request reading, sleep while response is transferred
+            if (sensor->begin_get_co2()) {
+                next_wake = now + CM1106_LP_POLL_INTERVAL;
+                state = CM1106_LP_READ;
+            } else {
+                finish(now, false);
+                new_reading = true;
+            }
+            break;
+
+        case CM1106_LP_READ:
+            switch (sensor->poll()) {
+                case CM1106_POLL_PENDING:
+                    next_wake = now + CM1106_LP_POLL_INTERVAL;
+                    break;
+                case CM1106_POLL_READY:
+                    finish(now, true);
+                    new_reading = true;
+                    break;
+                default:
+                    finish(now, false);
+                    new_reading = true;
+                    break;
+            }
+            break;
+    }
+
+    awake_us += cm1106_micros() - start_us;
+    return new_reading;
+}
+
+
+/* Get time (ms) of next step */
+uint32_t CM1106_LowPower::get_next_wake() {
+    return next_wake;
+}
+
+
+/* Get time (ms) until next step */
+uint32_t CM1106_LowPower::get_sleep_time() {
+    int32_t remaining = (int32_t)(next_wake - cm1106_millis());
+    return remaining > 0 ? remaining : 0;
+}
+
+
+/* Get last reading */
+bool CM1106_LowPower::get_reading(CM1106_reading *reading) {
+    if (!has_reading) {
+        return false;
+    }
+    *reading = this->reading;
+    return true;
+}
+
+
+uint8_t CM1106_LowPower::get_state() {
+    return state;
+}
+
+
+uint32_t CM1106_LowPower::get_awake_time() {
+    return awake_us;
+}
+
+
+uint32_t CM1106_LowPower::get_missed() {
+    return missed;
+}
+
+
+/* Drive power/enable of the sensor */
+void CM1106_LowPower::enable(bool enable) {
+    if (trigger != NULL) {
+        trigger(enable);
+    }
+}
+
+
+/* Period can not be shorter than a measurement */
+void CM1106_LowPower::clamp_period() {
+    if (period_ms <= measure_ms) {
+        CM1106_LOG("DEBUG: Period shorter than measure time, set to %lu ms!\n", (unsigned long)(measure_ms + 1));
+        period_ms = measure_ms + 1;
+    }
+}
+
+
+/* Store reading and schedule next measurement */
+void CM1106_LowPower::finish(uint32_t now, bool ok) {
+
+    enable(false);
+
+    reading.timestamp = now;
+    reading.co2 = ok ? sensor->get_last_co2() : 0;
+
+    // Read before the end of its single measurement, the sensor answers 0 ppm: no value yet
+    if (ok && now - trigger_time < CM1106_LP_MEASURE_TIME && reading.co2 == 0) {
+        CM1106_LOG("DEBUG: Measurement not finished, measure time too short!\n");
+        ok = false;
+    }
+    reading.status = ok ? CM1106_READING_OK : CM1106_READING_ERROR;
+    has_reading = true;
+
+    // Keep schedule without drift, skip periods already passed
+    next_wake = cycle_start + period_ms;
+    if ((int32_t)(now - next_wake) >= 0) {
+        uint32_t late = (now - next_wake) / period_ms + 1;
+        missed += late;
+        next_wake += late * period_ms;
+    }
+    state = CM1106_LP_SLEEP;
+}
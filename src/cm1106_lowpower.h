@@ -0,0 +1,81 @@
+/*
+    CM1106 Library for serial communication (UART)
+
+Copyright (c) 2021 Josep Comas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/    
+
+
+#ifndef _CM1106_LOWPOWER
+    #define _CM1106_LOWPOWER
+
+    #include "cm1106_uart.h"
+
+    #define CM1106_LP_MEASURE_TIME    2000   // Default time (ms) from trigger to valid measurement
+    #define CM1106_LP_POLL_INTERVAL      2   // Interval (ms) between checks of a pending response
+
+    /* States of duty cycle */
+    #define CM1106_LP_IDLE               0   // Not started
+    #define CM1106_LP_SLEEP              1   // Waiting next measurement
+    #define CM1106_LP_MEASURE            2   // Sensor triggered, measuring
+    #define CM1106_LP_READ               3   // Waiting response of reading
+
+
+    /* Duty-cycled acquisition for low power version CM1106SL-N. The sensor is put in single
+       measurement mode and triggered (power or enable pin) once per period; run() does the step
+       due at current time and returns at once, so the host can sleep until get_next_wake()
+       between steps: while the sensor measures and while its response is transferred. */
+    class CM1106_LowPower
+    {
+        public:
+            CM1106_LowPower(CM1106_Protocol &sensor, uint32_t period_ms);      // Initialize
+            void set_trigger(void (*trigger)(bool enable));                     // Set function driving power/enable of the sensor
+            void set_measure_time(uint32_t measure_ms);                         // Set time from trigger to valid measurement
+            bool begin();                                                       // Set single measurement mode, first measurement starts now
+            bool end();                                                         // Back to continuous measurement mode, sensor left enabled
+            bool run();                                                         // Do step due at current time, true when a new reading is available
+            uint32_t get_next_wake();                                           // Get time (ms, as cm1106_millis()) of next step
+            uint32_t get_sleep_time();                                          // Get time (ms) until next step, 0 if it is due
+            bool get_reading(CM1106_reading *reading);                          // Get last reading (false if none yet)
+            uint8_t get_state();                                                // Get state of duty cycle (CM1106_LP_xxx)
+            uint32_t get_awake_time();                                          // Get total time (us) spent in run()
+            uint32_t get_missed();                                              // Get periods skipped because host woke up too late
+
+        private:
+            CM1106_Protocol *sensor;                                            // Sampled sensor
+            void (*trigger)(bool enable);                                       // Power/enable of the sensor (NULL if not wired)
+            uint32_t period_ms;                                                 // Period of measurements
+            uint32_t measure_ms;                                                // Time from trigger to valid measurement
+            uint8_t state;                                                      // State of duty cycle (CM1106_LP_xxx)
+            uint32_t cycle_start;                                               // Scheduled time (ms) of current measurement
+            uint32_t trigger_time;                                              // Time (ms) sensor was triggered for current measurement
+            uint32_t next_wake;                                                 // Time (ms) of next step
+            bool has_reading;
+            CM1106_reading reading;                                             // Last reading
+            uint32_t awake_us;
+            uint32_t missed;
+
+            void enable(bool enable);                                           // Drive power/enable of the sensor
+            void clamp_period();                                                // Period can not be shorter than a measurement
+            void finish(uint32_t now, bool ok);                                 // Store reading and schedule next measurement
+    };
+
+#endif
@@ -0,0 +1,201 @@
+/*
+    CM1106 Library for serial communication (UART)
+
+Copyright (c) 2021 Josep Comas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include "cm1106_uart.h"
+
+#if (CM1106_PARSER_MAX_FRAME != CM1106_LEN_BUF_MSG)
+    #error "CM1106_PARSER_MAX_FRAME must be equal to CM1106_LEN_BUF_MSG"
+#endif
+
+#define CM1106_PARSER_MASK  (CM1106_PARSER_RING_SIZE - 1)
+
+
+/* Initialize */
+CM1106_Parser::CM1106_Parser()
+{
+#ifdef CM1106_STATS
+    resyncs = 0;
+    dropped = 0;
+    checksum_errors = 0;
+#endif
+    received = 0;
+    frame_len = 0;
+    response_len = 0;
+    reset();
+}
+
+
+/* Discard all stored bytes */
+void CM1106_Parser::reset() {
+    head = 0;
+    count = 0;
+    pos = 0;
+    expected = 0;
+    sum = 0;
+}
+
+
+/* Set total length of awaited ACK frame */
+void CM1106_Parser::expect(uint8_t len) {
+    response_len = len;
+}
+
+
+/* Store a received byte */
+bool CM1106_Parser::push(uint8_t data) {
+
+    if (count >= CM1106_PARSER_RING_SIZE) {
+        return false;
+    }
+
+    ring[(head + count) & CM1106_PARSER_MASK] = data;
+    count++;
+    received++;
+
+    return true;
+}
+
+
+/* Parse stored bytes */
+uint8_t CM1106_Parser::parse() {
+
+    while (pos < count) {
+        uint8_t data = ring[(head + pos) & CM1106_PARSER_MASK];
+
+        if (pos == 0) {
+            // Hunt header byte
+            if (data != CM1106_MSG_ACK && data != CM1106_MSG_NAK) {
+                discard(1);
+                CM1106_STAT(dropped++);
+                continue;
+            }
+            sum = data;
+            pos = 1;
+
+        } else if (pos == 1) {
+            // Length byte (NAK response has always 1 byte of data, ACK response the length of the awaited one)
+            if (data == 0 || data > CM1106_PARSER_MAX_FRAME - 3 || (ring[head] == CM1106_MSG_NAK && data != 1) ||
+                (ring[head] == CM1106_MSG_ACK && response_len != 0 && data + 3 != response_len)) {
+                resync();
+                continue;
+            }
+            sum += data;
+            expected = data + 3;
+            pos = 2;
+
+        } else {
+            // Data and checksum bytes, sum of all bytes of a valid frame is 0
+            sum += data;
+            pos++;
+
+            if (pos == expected) {
+                if (sum != 0) {
+                    CM1106_STAT(checksum_errors++);
+                    resync();
+                    continue;
+                }
+
+                for (uint8_t i = 0; i < expected; i++) {
+                    frame[i] = ring[(head + i) & CM1106_PARSER_MASK];
+                }
+                frame_len = expected;
+                discard(expected);
+
+                return (frame[0] == CM1106_MSG_ACK) ? CM1106_FRAME_ACK : CM1106_FRAME_NAK;
+            }
+        }
+    }
+
+    return CM1106_FRAME_NONE;
+}
+
+
+/* Get free space in ring buffer */
+uint8_t CM1106_Parser::get_free() {
+    return CM1106_PARSER_RING_SIZE - count;
+}
+
+
+/* Get last valid frame */
+const uint8_t *CM1106_Parser::get_frame() {
+    return frame;
+}
+
+
+/* Get length of last valid frame */
+uint8_t CM1106_Parser::get_frame_len() {
+    return frame_len;
+}
+
+
+#ifdef CM1106_STATS
+
+/* Get number of rejected candidate frames */
+uint16_t CM1106_Parser::get_resyncs() {
+    return resyncs;
+}
+
+
+/* Get number of discarded bytes */
+uint16_t CM1106_Parser::get_dropped() {
+    return dropped;
+}
+
+
+/* Get number of candidate frames with wrong checksum */
+uint16_t CM1106_Parser::get_checksum_errors() {
+    return checksum_errors;
+}
+
+#endif
+
+
+/* Get number of bytes stored */
+uint16_t CM1106_Parser::get_received() {
+    return received;
+}
+
+
+/* Get bytes stored not forming a frame yet */
+uint8_t CM1106_Parser::get_pending() {
+    return count;
+}
+
+
+/* Discard bytes from start of ring buffer */
+void CM1106_Parser::discard(uint8_t nb) {
+    head = (head + nb) & CM1106_PARSER_MASK;
+    count -= nb;
+    pos = 0;
+}
+
+
+/* Reject candidate frame, the bytes after its header are parsed again */
+void CM1106_Parser::resync() {
+    discard(1);
+    CM1106_STAT(dropped++);
+    CM1106_STAT(resyncs++);
+}
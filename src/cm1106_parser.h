@@ -0,0 +1,87 @@
+/*
+    CM1106 Library for serial communication (UART)
+
+Copyright (c) 2021 Josep Comas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/    
+
+
+#ifndef _CM1106_PARSER
+    #define _CM1106_PARSER
+
+    #include "Arduino.h"
+
+    #define CM1106_PARSER_RING_SIZE  32   // Size of ring buffer for received bytes (power of 2, greater than CM1106_LEN_BUF_MSG)
+    #define CM1106_PARSER_MAX_FRAME  20   // Max length of a frame (same as CM1106_LEN_BUF_MSG)
+
+    #define CM1106_FRAME_NONE         0   // No complete frame yet
+    #define CM1106_FRAME_ACK          1   // Valid ACK frame available
+    #define CM1106_FRAME_NAK          2   // Valid NAK frame available
+
+
+    /* Streaming parser of sensor responses.
+       Received bytes are stored in a ring buffer and parsed one by one: header byte (ACK/NAK),
+       length byte and checksum are validated incrementally. When a candidate frame is rejected
+       only its first byte is discarded and the following bytes are parsed again, so a good frame
+       after garbage is never lost. With the length of the awaited response, an ACK header with
+       another length byte is rejected at once: noise can not hold a candidate longer than the
+       response until the response is over. */
+    class CM1106_Parser
+    {
+        public:
+            CM1106_Parser();                                                    // Initialize
+            void reset();                                                       // Discard all stored bytes
+            void expect(uint8_t len);                                           // Set total length of awaited ACK frame (0 = any length)
+            bool push(uint8_t data);                                            // Store a received byte (false if ring buffer is full)
+            uint8_t parse();                                                    // Parse stored bytes, return CM1106_FRAME_xxx
+            uint8_t get_free();                                                 // Get free space in ring buffer
+            const uint8_t *get_frame();                                         // Get last valid frame
+            uint8_t get_frame_len();                                            // Get length of last valid frame
+#ifdef CM1106_STATS
+            uint16_t get_resyncs();                                             // Get number of rejected candidate frames
+            uint16_t get_dropped();                                             // Get number of discarded bytes
+            uint16_t get_checksum_errors();                                     // Get number of candidate frames with wrong checksum
+#endif
+            uint16_t get_received();                                            // Get number of bytes stored (tells a garbled exchange from a silent one)
+            uint8_t get_pending();                                              // Get bytes stored not forming a frame yet
+
+        private:
+            uint8_t ring[CM1106_PARSER_RING_SIZE];                              // Ring buffer of received bytes
+            uint8_t head;                                                       // Position of first byte of candidate frame
+            uint8_t count;                                                      // Bytes stored in ring buffer
+            uint8_t pos;                                                        // Bytes of candidate frame already parsed
+            uint8_t expected;                                                   // Total length of candidate frame
+            uint8_t response_len;                                               // Total length of awaited ACK frame (0 = any)
+            uint8_t sum;                                                        // Sum of parsed bytes of candidate frame
+            uint8_t frame[CM1106_PARSER_MAX_FRAME];                             // Last valid frame
+            uint8_t frame_len;                                                  // Length of last valid frame
+#ifdef CM1106_STATS
+            uint16_t resyncs;                                                   // Rejected candidate frames
+            uint16_t dropped;                                                   // Discarded bytes
+            uint16_t checksum_errors;                                           // Candidate frames with wrong checksum
+#endif
+            uint16_t received;                                                  // Stored bytes
+
+            void discard(uint8_t nb);                                           // Discard bytes from start of ring buffer
+            void resync();                                                      // Reject candidate frame and search next header
+    };
+
+#endif
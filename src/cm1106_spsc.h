@@ -0,0 +1,75 @@
+/*
+    CM1106 Library for serial communication (UART)
+
+Copyright (c) 2021 Josep Comas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/    
+
+
+#ifndef _CM1106_SPSC
+    #define _CM1106_SPSC
+
+    #include <atomic>
+
+    /* Wait-free single producer/single consumer ring of N elements (N power of 2).
+       push() is only called by the producer and pop() only by the consumer. */
+    template <typename T, uint16_t N>
+    class CM1106_SPSC
+    {
+        static_assert(N >= 2 && (N & (N - 1)) == 0, "Size of CM1106_SPSC must be a power of 2");
+
+        public:
+            CM1106_SPSC() : head(0), tail(0) {}
+
+            /* Add element (producer), false if ring is full */
+            bool push(const T &item) {
+                uint16_t t = tail.load(std::memory_order_relaxed);
+                if ((uint16_t)(t - head.load(std::memory_order_acquire)) >= N) {
+                    return false;
+                }
+                items[t & (N - 1)] = item;
+                tail.store(t + 1, std::memory_order_release);
+                return true;
+            }
+
+            /* Take oldest element (consumer), false if ring is empty */
+            bool pop(T *item) {
+                uint16_t h = head.load(std::memory_order_relaxed);
+                if (h == tail.load(std::memory_order_acquire)) {
+                    return false;
+                }
+                *item = items[h & (N - 1)];
+                head.store(h + 1, std::memory_order_release);
+                return true;
+            }
+
+            /* Number of stored elements */
+            uint16_t size() {
+                return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+            }
+
+        private:
+            T items[N];
+            std::atomic<uint16_t> head;                                         // Next element to read (written by consumer)
+            std::atomic<uint16_t> tail;                                         // Next element to write (written by producer)
+    };
+
+#endif
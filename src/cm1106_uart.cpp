@@ -25,7 +25,14 @@ SOFTWARE.
 
 
 #include "cm1106_uart.h"
-#include "time.h"
+#include "cm1106_commands.h"
+
+static_assert(CM1106_CAPS_MANDATORY == ((1 << CM1106_ID_GET_CO2) | (1 << CM1106_ID_GET_SOFTWARE_VERSION)), "Invalid mandatory capabilities");
+
+#define CM1106_EXCHANGE_OK        0   // Valid response
+#define CM1106_EXCHANGE_NAK       1   // Sensor refused the request
+#define CM1106_EXCHANGE_GARBLED   2   // Bytes received but no valid response (checksum, length)
+#define CM1106_EXCHANGE_SILENT    3   // No byte received
 
 #if (CM1106_LOG_LEVEL > CM1106_LOG_LEVEL_NONE)
     #ifdef CM1106_DEBUG_SOFTWARE_SERIAL
@@ -34,41 +41,60 @@ SOFTWARE.
 #endif
 
 /* Initialize */
-CM1106_UART::CM1106_UART(Stream &serial)
+CM1106_Protocol::CM1106_Protocol()
 {
-    mySerial = &serial;
+    pending_status = CM1106_POLL_IDLE;
+    pending_cmd = NULL;
+    pending_start = 0;
+    pending_timeout = 0;
+    tx_cmd = 0;
+    rx_buf = pending_frame;
+    rx_nb = 0;
+    last_co2 = 0;
+    last_abc.open_close = 0;
+    last_abc.cycle = 0;
+    last_abc.base = 0;
+    cache_enabled = false;
+    cache_valid = 0;
+    capabilities = CM1106_CAPS_ALL;
+    model = CM1106_MODEL_NONE;
+    adaptive = true;
+    retries = CM1106_RETRIES;
+    silent = 0;
+    pending_start_us = 0;
+    memset(rtt_avg, 0, sizeof(rtt_avg));
+    memset(rtt_dev, 0, sizeof(rtt_dev));
+    CM1106_STAT(reset_stats());
 }
 
 
 /* Get serial number */
-void CM1106_UART::get_serial_number(char sn[] ) {
+void CM1106_Protocol::get_serial_number(char sn[] ) {
 
     if (sn == NULL) {
         return;
     }
 
-    strcpy(sn, "");
+    CM1106_Guard guard(lock);
+    uint8_t frame[CM1106_LEN_BUF_MSG];
 
-    // Ask serial number
-    send_cmd(CM1106_CMD_GET_SERIAL_NUMBER);
+    if (cached(CM1106_CACHE_SN)) {
+        strcpy(sn, cache_sn);
+        return;
+    }
 
-    // Wait response
-    memset(buf_msg, 0, CM1106_LEN_BUF_MSG);
-    uint8_t nb = serial_read_bytes(14, CM1106_TIMEOUT);
+    strcpy(sn, "");
 
-    // Check response and get data
-    if (valid_response_len(CM1106_CMD_GET_SERIAL_NUMBER, nb, 14)) {
+    // Ask serial number and check response
+    if (transaction(CM1106_DESC_GET_SERIAL_NUMBER, NULL, frame)) {
 
-        uint16_t sn_int;
-        char sn_string[6];
+        format_serial_number(&frame[CM1106_POS_DATA], sn);
+        CM1106_LOG("DEBUG: Serial number: %s\n", sn);
 
-        for (int i = 0; i < 5; i++)
-        {
-            sn_int = ((buf_msg[3 + 2 * i] & 0x00FF) << 8) | (buf_msg[4 + 2 * i] & 0x00FF);
-            snprintf(sn_string, sizeof(sn_string), "%04d", sn_int);
-            strcat(sn, sn_string);
+        if (cache_enabled) {
+            strcpy(cache_sn, sn);
+            cache_valid |= CM1106_CACHE_SN;
         }
-        CM1106_LOG("DEBUG: Serial number: %s\n", sn);
 
     } else {
         CM1106_LOG("DEBUG: Serial number not available!\n");
@@ -78,25 +104,33 @@ void CM1106_UART::get_serial_number(char sn[] ) {
 
 
 /* Get software version */
-void CM1106_UART::get_software_version(char softver[]) {
+void CM1106_Protocol::get_software_version(char softver[]) {
 
     if (softver == NULL) {
         return;
     }
 
-    strcpy(softver, "");
+    CM1106_Guard guard(lock);
+    uint8_t frame[CM1106_LEN_BUF_MSG];
 
-    // Ask software version
-    send_cmd(CM1106_CMD_GET_SOFTWARE_VERSION);
+    if (cached(CM1106_CACHE_SOFTVER)) {
+        strcpy(softver, cache_softver);
+        return;
+    }
 
-    // Wait response
-    memset(buf_msg, 0, CM1106_LEN_BUF_MSG);
-    uint8_t nb = serial_read_bytes(15, CM1106_TIMEOUT);
+    strcpy(softver, "");
 
-    // Check response and get data
-    if (valid_response_len(CM1106_CMD_GET_SOFTWARE_VERSION, nb, 15)) {
-        strncpy(softver, (const char *)&buf_msg[3], CM1106_LEN_SOFTVER);
+    // Ask software version and check response
+    if (transaction(CM1106_DESC_GET_SOFTWARE_VERSION, NULL, frame)) {
+        memcpy(softver, &frame[CM1106_POS_DATA], CM1106_LEN_SOFTVER);
+        softver[CM1106_LEN_SOFTVER] = '\0';
         CM1106_LOG("DEBUG: Software version: %s\n", softver);
+
+        if (cache_enabled) {
+            strcpy(cache_softver, softver);
+            cache_valid |= CM1106_CACHE_SOFTVER;
+        }
+
     } else {
         CM1106_LOG("DEBUG: Software version not available!\n");
     }
@@ -105,20 +139,15 @@ void CM1106_UART::get_software_version(char softver[]) {
 
 
 /* Get CO2 value in ppm */
-int16_t CM1106_UART::get_co2() {
+int16_t CM1106_Protocol::get_co2() {
 
     int16_t co2 = 0;
+    uint8_t frame[CM1106_LEN_BUF_MSG];
 
-    // Ask CO2 value
-    send_cmd(CM1106_CMD_GET_CO2);
-
-    // Wait response
-    memset(buf_msg, 0, CM1106_LEN_BUF_MSG);
-    uint8_t nb = serial_read_bytes(8, CM1106_TIMEOUT);
-
-    // Check response and get data
-    if (valid_response_len(CM1106_CMD_GET_CO2, nb, 8)) {
-        co2 = (buf_msg[3] * 256) + buf_msg[4];
+    // Ask CO2 value and check response
+    if (transaction(CM1106_DESC_GET_CO2, NULL, frame)) {
+        const uint8_t *data = &frame[CM1106_POS_DATA];
+        co2 = (data[0] << 8) | data[1];
         CM1106_LOG("DEBUG: CO2 value = %d ppm\n", co2);
     } else {
         CM1106_LOG("DEBUG: Error getting CO2 value!\n");
@@ -127,25 +156,39 @@ int16_t CM1106_UART::get_co2() {
 }
 
 
+/* Get CO2 value in ppm, false on error (0 ppm may be a valid reading) */
+bool CM1106_Protocol::get_co2(int16_t *co2) {
+    uint8_t frame[CM1106_LEN_BUF_MSG];
+
+    if (co2 == NULL) {
+        return false;
+    }
+
+    // Ask CO2 value and check response
+    if (!transaction(CM1106_DESC_GET_CO2, NULL, frame)) {
+        CM1106_LOG("DEBUG: Error getting CO2 value!\n");
+        return false;
+    }
+
+    const uint8_t *data = &frame[CM1106_POS_DATA];
+    *co2 = (data[0] << 8) | data[1];
+    CM1106_LOG("DEBUG: CO2 value = %d ppm\n", *co2);
+
+    return true;
+}
+
+
 /* Start calibration */
-bool CM1106_UART::start_calibration(int16_t concentration) {
+bool CM1106_Protocol::start_calibration(int16_t concentration) {
     bool result = false;
 
     if (concentration >= 400 && concentration <= 1500) {
 
-        // Put data
-        buf_msg[3] = (concentration & 0xFF00 ) >> 8;
-        buf_msg[4] = (concentration & 0xFF);
-
-        // Ask start calibration
-        send_cmd_data(CM1106_CMD_START_CALIBRATION, 6);
-
-        // Wait response
-        memset(buf_msg, 0, CM1106_LEN_BUF_MSG);
-        uint8_t nb = serial_read_bytes(4, CM1106_TIMEOUT);
+        uint8_t data[2] = {(uint8_t)((concentration & 0xFF00) >> 8), (uint8_t)(concentration & 0xFF)};
+        uint8_t frame[CM1106_LEN_BUF_MSG];
 
-        // Check response and get data
-        if (valid_response_len(CM1106_CMD_START_CALIBRATION, nb, 4)) {
+        // Ask start calibration and check response
+        if (transaction(CM1106_DESC_START_CALIBRATION, data, frame)) {
             result = true;
             CM1106_LOG("DEBUG: Successful start of calibration\n");
         } else {
@@ -161,28 +204,18 @@ bool CM1106_UART::start_calibration(int16_t concentration) {
 
 
 /* Setting ABC */
-bool CM1106_UART::set_ABC(uint8_t open_close, uint8_t cycle, int16_t base) {
+bool CM1106_Protocol::set_ABC(uint8_t open_close, uint8_t cycle, int16_t base) {
     bool result = false;
 
     if ((open_close == CM1106_ABC_OPEN || open_close == CM1106_ABC_CLOSE) && cycle >= 1 && cycle <= 7 && base >= 400 && base <= 1499) {
 
-        // Put ABC parameters in buffer
-        buf_msg[3] = 0x64;
-        buf_msg[4] = open_close;
-        buf_msg[5] = cycle;
-        buf_msg[6] = (base & 0xFF00 ) >> 8;
-        buf_msg[7] = (base & 0xFF);
-        buf_msg[8] = 0x64;
+        CM1106_Guard guard(lock);
+        uint8_t data[6] = {0x64, open_close, cycle, (uint8_t)((base & 0xFF00) >> 8), (uint8_t)(base & 0xFF), 0x64};
+        uint8_t frame[CM1106_LEN_BUF_MSG];
 
-        // Ask set ABC
-        send_cmd_data(CM1106_CMD_SET_ABC, 10);
-
-        // Wait response
-        memset(buf_msg, 0, CM1106_LEN_BUF_MSG);
-        uint8_t nb = serial_read_bytes(4, CM1106_TIMEOUT);
-
-        // Check response and get data
-        if (valid_response_len(CM1106_CMD_SET_ABC, nb, 4)) {
+        // Ask set ABC and check response
+        if (transaction(CM1106_DESC_SET_ABC, data, frame)) {
+            invalidate_cache(CM1106_CACHE_ABC);
             result = true;
             CM1106_LOG("DEBUG: Successful setting of ABC\n");
         } else {
@@ -198,26 +231,29 @@ bool CM1106_UART::set_ABC(uint8_t open_close, uint8_t cycle, int16_t base) {
 
 
 /* Getting ABC */
-bool CM1106_UART::get_ABC(CM1106_ABC *abc) {
+bool CM1106_Protocol::get_ABC(CM1106_ABC *abc) {
     bool result = false;
 
     if (abc == NULL)
         return result;
 
-    abc->open_close = 0; abc->cycle = 0; abc->base = 0;
+    CM1106_Guard guard(lock);
+    uint8_t frame[CM1106_LEN_BUF_MSG];
 
-    // Ask get ABC parameters
-    send_cmd(CM1106_CMD_GET_ABC);
+    if (cached(CM1106_CACHE_ABC)) {
+        *abc = cache_abc;
+        return true;
+    }
 
-    // Wait response
-    uint8_t nb = serial_read_bytes(10, CM1106_TIMEOUT);
-
-    // Check response and get data
-    if (valid_response_len(CM1106_CMD_GET_ABC, nb, 10)) {
-        abc->open_close = buf_msg[4];
-        abc->cycle = buf_msg[5];
-        //abc->base = (buf_msg[6] * 256) + buf_msg[7];
-        abc->base = (buf_msg[6] << 8) | buf_msg[7];
+    abc->open_close = 0; abc->cycle = 0; abc->base = 0;
+
+    // Ask get ABC parameters and check response
+    if (transaction(CM1106_DESC_GET_ABC, NULL, frame)) {
+        decode_ABC(&frame[CM1106_POS_DATA], abc);
+        if (cache_enabled) {
+            cache_abc = *abc;
+            cache_valid |= CM1106_CACHE_ABC;
+        }
         result = true;
         CM1106_LOG("DEBUG: Successful getting ABC parameters\n");
     } else {
@@ -229,17 +265,12 @@ bool CM1106_UART::get_ABC(CM1106_ABC *abc) {
 
 
 /* Storing ABC data */
-bool CM1106_UART::store_ABC_data() {
+bool CM1106_Protocol::store_ABC_data() {
     bool result = false;
+    uint8_t frame[CM1106_LEN_BUF_MSG];
 
-    // Ask store ABC data
-    send_cmd(CM1106_CMD_STORE_ABC_DATA);
-
-    // Wait response
-    uint8_t nb = serial_read_bytes(4, CM1106_TIMEOUT);
-
-    // Check response and get data
-    if (valid_response_len(CM1106_CMD_STORE_ABC_DATA, nb, 4)) {
+    // Ask store ABC data and check response
+    if (transaction(CM1106_DESC_STORE_ABC_DATA, NULL, frame)) {
         result = true;
         CM1106_LOG("DEBUG: Successful storing ABC data!\n");
     } else {
@@ -251,25 +282,18 @@ bool CM1106_UART::store_ABC_data() {
 
 
 /* Setting measurement period and smoothed data */
-bool CM1106_UART::set_measurement_period(int16_t period, uint8_t smoothed) {
+bool CM1106_Protocol::set_measurement_period(int16_t period, uint8_t smoothed) {
     bool result = false;
 
     if (period >= 1 && period <= 600) {
 
-        // Put data in buffer
-        buf_msg[3] = (period & 0xFF00 ) >> 8;
-        buf_msg[4] = (period & 0xFF);
-        buf_msg[5] = smoothed;
-
-        // Ask set measurement period and number of smoothed data
-        send_cmd_data(CM1106_CMD_MEASUREMENT_PERIOD, 7);
-
-        // Wait response
-        memset(buf_msg, 0, CM1106_LEN_BUF_MSG);
-        uint8_t nb = serial_read_bytes(4, CM1106_TIMEOUT);
+        CM1106_Guard guard(lock);
+        uint8_t data[3] = {(uint8_t)((period & 0xFF00) >> 8), (uint8_t)(period & 0xFF), smoothed};
+        uint8_t frame[CM1106_LEN_BUF_MSG];
 
-        // Check response and get data
-        if (valid_response_len(CM1106_CMD_MEASUREMENT_PERIOD, nb, 4)) {
+        // Ask set measurement period and number of smoothed data and check response
+        if (transaction(CM1106_DESC_SET_MEASUREMENT_PERIOD, data, frame)) {
+            invalidate_cache(CM1106_CACHE_PERIOD);
             result = true;
             CM1106_LOG("DEBUG: Successful setting of measurement period\n");
         } else {
@@ -285,27 +309,35 @@ bool CM1106_UART::set_measurement_period(int16_t period, uint8_t smoothed) {
 
 
 /* Getting measurement period and smoothed data */
-bool CM1106_UART::get_measurement_period(int16_t *period, uint8_t *smoothed) {
+bool CM1106_Protocol::get_measurement_period(int16_t *period, uint8_t *smoothed) {
     bool result = false;
 
     if (period == NULL || smoothed == NULL)
         return result;
 
-    // Ask set measurement period and number of smoothed data
-    send_cmd_data(CM1106_CMD_MEASUREMENT_PERIOD, 4);
+    CM1106_Guard guard(lock);
+    uint8_t frame[CM1106_LEN_BUF_MSG];
 
-    // Wait response
-    memset(buf_msg, 0, CM1106_LEN_BUF_MSG);
-    uint8_t nb = serial_read_bytes(7, CM1106_TIMEOUT);
+    if (cached(CM1106_CACHE_PERIOD)) {
+        *period = cache_period;
+        *smoothed = cache_smoothed;
+        return true;
+    }
 
-    // Check response and get data
-    if (valid_response_len(CM1106_CMD_MEASUREMENT_PERIOD, nb, 7)) {
-        *period = (buf_msg[3] << 8) | buf_msg[4];
-        *smoothed = buf_msg[5];
+    // Ask measurement period and number of smoothed data and check response
+    if (transaction(CM1106_DESC_GET_MEASUREMENT_PERIOD, NULL, frame)) {
+        const uint8_t *data = &frame[CM1106_POS_DATA];
+        *period = (data[0] << 8) | data[1];
+        *smoothed = data[2];
+        if (cache_enabled) {
+            cache_period = *period;
+            cache_smoothed = *smoothed;
+            cache_valid |= CM1106_CACHE_PERIOD;
+        }
         result = true;
-        CM1106_LOG("DEBUG: Successful setting of measurement period\n");
+        CM1106_LOG("DEBUG: Successful getting of measurement period\n");
     } else {
-        CM1106_LOG("DEBUG: Error in setting of measurement period!\n");
+        CM1106_LOG("DEBUG: Error in getting of measurement period!\n");
     }
 
     return result;
@@ -313,23 +345,17 @@ bool CM1106_UART::get_measurement_period(int16_t *period, uint8_t *smoothed) {
 
 
 /* Setting working status */
-bool CM1106_UART::set_working_status(uint8_t mode) {
+bool CM1106_Protocol::set_working_status(uint8_t mode) {
     bool result = false;
 
     if ((mode == CM1106_SINGLE_MEASUREMENT || mode == CM1106_CONTINUOUS_MEASUREMENT)) {
 
-        // Put measurement mode in buffer
-        buf_msg[3] = mode;
+        CM1106_Guard guard(lock);
+        uint8_t frame[CM1106_LEN_BUF_MSG];
 
-        // Ask set measurement mode
-        send_cmd_data(CM1106_CMD_WORKING_STATUS, 5);
-
-        // Wait response
-        memset(buf_msg, 0, CM1106_LEN_BUF_MSG);
-        uint8_t nb = serial_read_bytes(4, CM1106_TIMEOUT);
-
-        // Check response and get data
-        if (valid_response_len(CM1106_CMD_WORKING_STATUS, nb, 4)) {
+        // Ask set measurement mode and check response
+        if (transaction(CM1106_DESC_SET_WORKING_STATUS, &mode, frame)) {
+            invalidate_cache(CM1106_CACHE_STATUS);
             result = true;
             CM1106_LOG("DEBUG: Successful setting of measurement mode\n");
         } else {
@@ -345,22 +371,27 @@ bool CM1106_UART::set_working_status(uint8_t mode) {
 
 
 /* Getting working status */
-bool CM1106_UART::get_working_status(uint8_t *mode) {
+bool CM1106_Protocol::get_working_status(uint8_t *mode) {
     bool result = false;
 
     if (mode == NULL)
         return result;
 
-    // Ask set measurement mode
-    send_cmd_data(CM1106_CMD_WORKING_STATUS, 4);
+    CM1106_Guard guard(lock);
+    uint8_t frame[CM1106_LEN_BUF_MSG];
 
-    // Wait response
-    memset(buf_msg, 0, CM1106_LEN_BUF_MSG);
-    uint8_t nb = serial_read_bytes(5, CM1106_TIMEOUT);
+    if (cached(CM1106_CACHE_STATUS)) {
+        *mode = cache_status;
+        return true;
+    }
 
-    // Check response and get data
-    if (valid_response_len(CM1106_CMD_WORKING_STATUS, nb, 5)) {
-        *mode = buf_msg[3];
+    // Ask measurement mode and check response
+    if (transaction(CM1106_DESC_GET_WORKING_STATUS, NULL, frame)) {
+        *mode = frame[CM1106_POS_DATA];
+        if (cache_enabled) {
+            cache_status = *mode;
+            cache_valid |= CM1106_CACHE_STATUS;
+        }
         result = true;
         CM1106_LOG("DEBUG: Successful getting working status\n");
     } else {
@@ -371,57 +402,805 @@ bool CM1106_UART::get_working_status(uint8_t *mode) {
 }
 
 
+/* Enable/disable cache of device metadata */
+void CM1106_Protocol::enable_cache(bool enable) {
+    CM1106_Guard guard(lock);
+    cache_enabled = enable;
+    cache_valid = 0;
+}
+
+
+/* Invalidate cache and read all metadata again */
+uint8_t CM1106_Protocol::refresh() {
+    char sn[CM1106_LEN_SN + 1];
+    char softver[CM1106_LEN_SOFTVER + 1];
+    CM1106_ABC abc;
+    int16_t period;
+    uint8_t smoothed, mode;
+
+    CM1106_Guard guard(lock);
+    cache_valid = 0;
+    if (!cache_enabled) {
+        return 0;
+    }
+
+    // Read all items back to back, they are stored in cache by the getters
+    get_serial_number(sn);
+    get_software_version(softver);
+    get_ABC(&abc);
+    get_measurement_period(&period, &smoothed);
+    get_working_status(&mode);
+
+    CM1106_LOG("DEBUG: Cached metadata 0x%02x\n", cache_valid);
+
+    return cache_valid;
+}
+
+
+/* Invalidate cached items */
+void CM1106_Protocol::invalidate_cache(uint8_t items) {
+    CM1106_Guard guard(lock);
+    cache_valid &= ~items;
+}
+
+
+/* Check if item is cached */
+bool CM1106_Protocol::cached(uint8_t item) {
+    return cache_enabled && (cache_valid & item);
+}
+
+
+/* Format serial number (5 numbers of at least 4 digits) without printf */
+void CM1106_Protocol::format_serial_number(const uint8_t *data, char sn[]) {
+    uint8_t len = 0;
+
+    for (uint8_t i = 0; i < 5; i++) {
+        uint16_t sn_int = (data[2 * i] << 8) | data[2 * i + 1];
+        uint8_t digits = (sn_int > 9999) ? 5 : 4;
+
+        for (int8_t d = digits - 1; d >= 0; d--) {
+            if (len + d < CM1106_LEN_SN) {
+                sn[len + d] = '0' + (sn_int % 10);
+            }
+            sn_int /= 10;
+        }
+        len += digits;
+    }
+
+    sn[(len < CM1106_LEN_SN) ? len : CM1106_LEN_SN] = '\0';
+}
+
+
+/* Detect sensor with a short deadline, read version and serial number and classify the model */
+uint8_t CM1106_Protocol::probe(CM1106_sensor *sensor) {
+    const CM1106_command &command = CM1106_DESC_GET_SOFTWARE_VERSION;
+    uint8_t frame[CM1106_LEN_BUF_MSG];
+    char softver[CM1106_LEN_SOFTVER + 1];
+    char sn[CM1106_LEN_SN + 1];
+    bool present = false;
+
+    CM1106_Guard guard(lock);
+    capabilities = CM1106_CAPS_ALL;
+    model = CM1106_MODEL_NONE;
+    softver[0] = '\0';
+    sn[0] = '\0';
+
+    // Presence: software version with a deadline of a few response times instead of the full retry policy
+    for (uint8_t attempt = 0; attempt < CM1106_PROBE_ATTEMPTS && !present; attempt++) {
+        unsigned long start_us = cm1106_micros();
+        present = transaction(command, NULL, frame, CM1106_PROBE_TIMEOUT);
+        if (present) {
+            update_rtt(command, cm1106_micros() - start_us);
+        }
+    }
+
+    if (!present) {
+        // Next requests fail after a short wait, until the sensor answers
+        silent = CM1106_LOST_TIMEOUTS;
+        CM1106_LOG("DEBUG: Sensor not found!\n");
+        if (sensor != NULL) {
+            sensor->softver[0] = '\0';
+            sensor->sn[0] = '\0';
+        }
+        return model;
+    }
+    silent = 0;
+    memcpy(softver, &frame[CM1106_POS_DATA], CM1106_LEN_SOFTVER);
+    softver[CM1106_LEN_SOFTVER] = '\0';
+
+    // Serial number back to back, the latency of the sensor is known
+    if (transaction(CM1106_DESC_GET_SERIAL_NUMBER, NULL, frame)) {
+        format_serial_number(&frame[CM1106_POS_DATA], sn);
+    }
+
+    // Model from software version: low power versions end with SL-N or SL-NS
+    if (strstr(softver, "SL-N") != NULL) {
+        model = CM1106_MODEL_SL_N;
+        capabilities = CM1106_CAPS_ALL;
+    } else if (!strncmp(softver, "CM", 2)) {
+        model = CM1106_MODEL_CM1106;
+        capabilities = CM1106_CAPS_CM1106;
+    } else {
+        model = CM1106_MODEL_UNKNOWN;
+    }
+
+    if (cache_enabled) {
+        strcpy(cache_softver, softver);
+        cache_valid |= CM1106_CACHE_SOFTVER;
+        if (sn[0] != '\0') {
+            strcpy(cache_sn, sn);
+            cache_valid |= CM1106_CACHE_SN;
+        }
+    }
+    if (sensor != NULL) {
+        strcpy(sensor->softver, softver);
+        strcpy(sensor->sn, sn);
+    }
+
+    CM1106_LOG("DEBUG: Model %d detected, software version %s, serial number %s\n", model, softver, sn);
+
+    return model;
+}
+
+
+/* Get model detected by last probe */
+uint8_t CM1106_Protocol::get_model() {
+    return model;
+}
+
+
+/* Detect supported commands with short timeouts */
+bool CM1106_Protocol::probe_capabilities(CM1106_capabilities *caps) {
+
+    if (caps == NULL) {
+        return false;
+    }
+
+    // Read commands probed, and write commands assumed supported with each one (never sent while probing)
+    static const struct {
+        const CM1106_command *probe;
+        uint16_t commands;
+    } probes[] = {
+        {&CM1106_DESC_GET_CO2,                (1 << CM1106_ID_GET_CO2) | (1 << CM1106_ID_START_CALIBRATION)},
+        {&CM1106_DESC_GET_ABC,                (1 << CM1106_ID_GET_ABC) | (1 << CM1106_ID_SET_ABC)},
+        {&CM1106_DESC_GET_SERIAL_NUMBER,      (1 << CM1106_ID_GET_SERIAL_NUMBER)},
+        {&CM1106_DESC_GET_MEASUREMENT_PERIOD, (1 << CM1106_ID_GET_MEASUREMENT_PERIOD) | (1 << CM1106_ID_SET_MEASUREMENT_PERIOD) | (1 << CM1106_ID_STORE_ABC_DATA)},
+        {&CM1106_DESC_GET_WORKING_STATUS,     (1 << CM1106_ID_GET_WORKING_STATUS) | (1 << CM1106_ID_SET_WORKING_STATUS)},
+    };
+
+    CM1106_Guard guard(lock);
+    uint8_t frame[CM1106_LEN_BUF_MSG];
+    uint32_t latency_us;
+
+    capabilities = CM1106_CAPS_ALL;
+    caps->softver[0] = '\0';
+    caps->commands = 0;
+
+    // Software version identifies the firmware and gives the latency of the sensor
+    if (!measure_latency(frame, &latency_us)) {
+        CM1106_LOG("DEBUG: Sensor not answering, capabilities not probed!\n");
+        return false;
+    }
+    memcpy(caps->softver, &frame[CM1106_POS_DATA], CM1106_LEN_SOFTVER);
+    caps->softver[CM1106_LEN_SOFTVER] = '\0';
+    caps->commands = 1 << CM1106_ID_GET_SOFTWARE_VERSION;
+
+    // Unsupported commands are answered with NAK or not answered at all. A garbled answer comes
+    // from the sensor: it is retried, and the command is kept if it stays garbled.
+    for (uint8_t i = 0; i < sizeof(probes) / sizeof(probes[0]); i++) {
+        const CM1106_command &command = *probes[i].probe;
+        uint16_t timeout = probe_timeout(latency_us, command.req_len + command.resp_len);
+        uint16_t backoff = CM1106_BACKOFF;
+        uint8_t silences = 0;
+        uint8_t garbled = 0;
+        bool supported = true;
+
+        while (true) {
+            uint8_t result = exchange(command, NULL, frame, timeout);
+            if (result == CM1106_EXCHANGE_OK) {
+                break;
+            }
+            if (result == CM1106_EXCHANGE_NAK) {
+                supported = false;
+                break;
+            }
+            if (result == CM1106_EXCHANGE_SILENT) {
+                if (++silences >= CM1106_PROBE_SILENCES) {
+                    supported = false;
+                    break;
+                }
+            } else {
+                if (garbled++ >= retries) {
+                    break;
+                }
+                cm1106_delay(backoff);
+                backoff *= 2;
+            }
+        }
+
+        if (supported) {
+            caps->commands |= probes[i].commands;
+        }
+    }
+
+    // Reading CO2 and identifying the sensor are never disabled
+    caps->commands |= CM1106_CAPS_MANDATORY;
+
+    capabilities = caps->commands;
+    CM1106_LOG("DEBUG: Capabilities of %s: 0x%04x\n", caps->softver, capabilities);
+
+    return true;
+}
+
+
+/* Apply capabilities saved by the caller, if software version matches */
+bool CM1106_Protocol::set_capabilities(const CM1106_capabilities *caps) {
+
+    if (caps == NULL) {
+        return false;
+    }
+
+    CM1106_Guard guard(lock);
+    char softver[CM1106_LEN_SOFTVER + 1];
+
+    capabilities = CM1106_CAPS_ALL;
+    get_software_version(softver);
+
+    if (strncmp(softver, caps->softver, CM1106_LEN_SOFTVER) != 0) {
+        CM1106_LOG("DEBUG: Capabilities of %s do not match sensor %s!\n", caps->softver, softver);
+        return false;
+    }
+
+    capabilities = caps->commands | CM1106_CAPS_MANDATORY;
+
+    return true;
+}
+
+
+/* Check if a command is supported */
+bool CM1106_Protocol::is_supported(uint8_t cmd) {
+    for (uint8_t i = 0; i < CM1106_NUM_COMMANDS; i++) {
+        if (CM1106_DESCRIPTORS[i]->cmd == cmd && (capabilities & (1 << i))) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/* Get software version in frame and measure response latency of the sensor */
+bool CM1106_Protocol::measure_latency(uint8_t frame[], uint32_t *latency_us) {
+    const CM1106_command &command = CM1106_DESC_GET_SOFTWARE_VERSION;
+
+    unsigned long start = cm1106_micros();
+    if (!transaction(command, NULL, frame)) {
+        return false;
+    }
+    uint32_t elapsed = cm1106_micros() - start;
+
+    // Time not spent transferring bytes
+    uint32_t transfer = (uint32_t)(command.req_len + command.resp_len) * CM1106_BYTE_TIME;
+    *latency_us = elapsed > transfer ? elapsed - transfer : 0;
+
+    return true;
+}
+
+
+/* Timeout (ms) of a probe transferring nb_bytes: twice the latency measured plus transfer time */
+uint16_t CM1106_Protocol::probe_timeout(uint32_t latency_us, uint8_t nb_bytes) {
+    uint32_t timeout = (2 * latency_us + nb_bytes * CM1106_BYTE_TIME) / 1000 + CM1106_PROBE_MARGIN;
+
+    return timeout < CM1106_TIMEOUT_MS ? timeout : CM1106_TIMEOUT_MS;
+}
+
+
+/* Enable/disable adaptive timeouts */
+void CM1106_Protocol::set_adaptive_timeout(bool enable) {
+    CM1106_Guard guard(lock);
+    adaptive = enable;
+}
+
+
+/* Set retries of garbled responses */
+void CM1106_Protocol::set_retries(uint8_t retries) {
+    CM1106_Guard guard(lock);
+    this->retries = retries;
+}
+
+
+/* Get current timeout (ms) of a command */
+uint16_t CM1106_Protocol::get_timeout(uint8_t id) {
+    if (id >= CM1106_NUM_COMMANDS) {
+        return 0;
+    }
+
+    CM1106_Guard guard(lock);
+
+    return rto(*CM1106_DESCRIPTORS[id]);
+}
+
+
+/* Check if the sensor stopped answering */
+bool CM1106_Protocol::is_lost() {
+    return silent >= CM1106_LOST_TIMEOUTS;
+}
+
+
+/* Drop pending request and received bytes until the line is quiet */
+void CM1106_Protocol::flush() {
+    CM1106_Guard guard(lock);
+
+    if (pending_status == CM1106_POLL_PENDING) {
+        pending_status = CM1106_POLL_ERROR;
+    }
+
+    // Rest of a late response or noise of a desynchronized line, bounded by the timeout of a request
+    unsigned long start = cm1106_millis();
+    unsigned long last = start;
+    uint16_t nb = 0;
+    while (cm1106_millis() - last < CM1106_FLUSH_QUIET && cm1106_millis() - start < CM1106_TIMEOUT_MS) {
+        uint16_t discarded = discard_stale();
+        if (discarded > 0) {
+            nb += discarded;
+            last = cm1106_millis();
+        } else {
+            cm1106_delay(1);
+        }
+    }
+
+    CM1106_LOG("DEBUG: Flushed %u bytes\n", nb);
+}
+
+
+#ifdef CM1106_STATS
+
+/* Copy statistics (without lock, counters may be updated while copying) */
+void CM1106_Protocol::get_stats(CM1106_stats *stats) {
+    if (stats != NULL) {
+        memcpy(stats, &this->stats, sizeof(CM1106_stats));
+    }
+}
+
+
+/* Clear statistics */
+void CM1106_Protocol::reset_stats() {
+    CM1106_Guard guard(lock);
+
+    memset(&stats, 0, sizeof(CM1106_stats));
+    stats_resyncs = parser.get_resyncs();
+    stats_checksum_errors = parser.get_checksum_errors();
+    stats_received = parser.get_received();
+}
+
+
+/* Count result of a request (nb is 0 if no valid frame was received) */
+void CM1106_Protocol::stats_response(const CM1106_command &command, const uint8_t frame[], uint8_t nb, unsigned long start) {
+    static const uint16_t bounds[CM1106_STATS_BUCKETS - 1] = {10, 15, 20, 30, 50, 100, 200};
+
+    stats.transactions[command.id]++;
+
+    // Parser counters wrap around, only their increments are added
+    uint16_t value = parser.get_resyncs();
+    stats.resyncs += (uint16_t)(value - stats_resyncs);
+    stats_resyncs = value;
+    value = parser.get_checksum_errors();
+    stats.checksum_errors += (uint16_t)(value - stats_checksum_errors);
+    stats_checksum_errors = value;
+    value = parser.get_received();
+    stats.bytes_rx += (uint16_t)(value - stats_received);
+    stats_received = value;
+
+    if (nb == 0) {
+        if (parser.get_pending() > 0) {
+            stats.short_frames++;
+        } else {
+            stats.timeouts++;
+        }
+        return;
+    }
+
+    if (frame[0] == CM1106_MSG_NAK) {
+        stats.naks++;
+        stats.nak_codes[frame[2] < CM1106_STATS_NAK_CODES ? frame[2] : CM1106_STATS_NAK_CODES - 1]++;
+    } else if (nb != command.resp_len) {
+        stats.short_frames++;
+    }
+
+    unsigned long latency = cm1106_millis() - start;
+    uint8_t bucket = 0;
+    while (bucket < CM1106_STATS_BUCKETS - 1 && latency >= bounds[bucket]) {
+        bucket++;
+    }
+    stats.latency[bucket]++;
+}
+
+#endif
+
+
+/* Send CO2 request without waiting response */
+bool CM1106_Protocol::begin_get_co2() {
+    return begin_request(CM1106_DESC_GET_CO2);
+}
+
+
+/* Send ABC request without waiting response */
+bool CM1106_Protocol::begin_get_ABC() {
+    return begin_request(CM1106_DESC_GET_ABC);
+}
+
+
+/* Send request without data and without waiting response */
+bool CM1106_Protocol::begin_request(const CM1106_command &command) {
+    CM1106_Guard guard(lock);
+
+    if (pending_status == CM1106_POLL_PENDING) {
+        CM1106_LOG("DEBUG: Request already in progress!\n");
+        return false;
+    }
+
+    if (!(capabilities & (1 << command.id))) {
+        CM1106_LOG("DEBUG: Command 0x%02x not supported!\n", command.cmd);
+        return false;
+    }
+
+    send_request(command, NULL);
+
+    start_receive(pending_frame);
+    pending_cmd = &command;
+    pending_status = CM1106_POLL_PENDING;
+    pending_timeout = rto(command);
+    pending_start = cm1106_millis();
+    pending_start_us = cm1106_micros();
+
+    return true;
+}
+
+
+/* Process received bytes of pending request */
+uint8_t CM1106_Protocol::poll() {
+    CM1106_Guard guard(lock);
+
+    // Take only the bytes already received, never wait
+    if (pending_status == CM1106_POLL_PENDING) {
+        update_pending(false);
+    }
+
+    // Result is returned once
+    uint8_t status = pending_status;
+    if (status != CM1106_POLL_PENDING) {
+        pending_status = CM1106_POLL_IDLE;
+    }
+
+    return status;
+}
+
+
+/* Check response of pending non-blocking request (waiting it if wait is true) */
+void CM1106_Protocol::update_pending(bool wait) {
+    unsigned long elapsed = cm1106_millis() - pending_start;
+    bool complete;
+
+    rx_buf = pending_frame;
+    if (wait && elapsed < pending_timeout) {
+        complete = wait_response(pending_timeout - elapsed);
+    } else {
+        complete = receive_bytes();
+    }
+
+    if (complete) {
+        CM1106_STAT(stats_response(*pending_cmd, pending_frame, rx_nb, pending_start));
+        silent = 0;
+
+        if (valid_response_len(pending_cmd->cmd, pending_frame, rx_nb, pending_cmd->resp_len)) {
+            update_rtt(*pending_cmd, cm1106_micros() - pending_start_us);
+            const uint8_t *data = &pending_frame[CM1106_POS_DATA];
+            if (pending_cmd->id == CM1106_ID_GET_CO2) {
+                last_co2 = (data[0] << 8) | data[1];
+                CM1106_LOG("DEBUG: CO2 value = %d ppm\n", last_co2);
+            } else if (pending_cmd->id == CM1106_ID_GET_ABC) {
+                decode_ABC(data, &last_abc);
+                if (cache_enabled) {
+                    cache_abc = last_abc;
+                    cache_valid |= CM1106_CACHE_ABC;
+                }
+                CM1106_LOG("DEBUG: Successful getting ABC parameters\n");
+            }
+            pending_status = CM1106_POLL_READY;
+        } else {
+            CM1106_LOG("DEBUG: Error in response of command 0x%02x!\n", pending_cmd->cmd);
+            pending_status = CM1106_POLL_ERROR;
+        }
+
+    } else if (cm1106_millis() - pending_start >= pending_timeout) {
+        // No response: the request cannot be sent again, its response is waited until the full timeout of the command, unless the sensor is lost
+        if (pending_timeout < pending_cmd->timeout_ms && !is_lost()) {
+            pending_timeout = pending_cmd->timeout_ms;
+            if (wait) {
+                update_pending(true);
+            }
+            return;
+        }
+        CM1106_STAT(stats_response(*pending_cmd, pending_frame, 0, pending_start));
+        if (silent < 255) {
+            silent++;
+        }
+        CM1106_LOG("DEBUG: Timeout waiting response of command 0x%02x!\n", pending_cmd->cmd);
+        pending_status = CM1106_POLL_ERROR;
+    }
+}
+
+
+/* Get CO2 value of last completed non-blocking request */
+int16_t CM1106_Protocol::get_last_co2() {
+    return last_co2;
+}
+
+
+/* Get ABC parameters of last completed non-blocking request */
+bool CM1106_Protocol::get_last_ABC(CM1106_ABC *abc) {
+
+    if (abc == NULL) {
+        return false;
+    }
+
+    *abc = last_abc;
+
+    return true;
+}
+
+
+/* Decode ABC parameters of response */
+void CM1106_Protocol::decode_ABC(const uint8_t *data, CM1106_ABC *abc) {
+    abc->open_close = data[1];
+    abc->cycle = data[2];
+    abc->base = (data[3] << 8) | data[4];
+}
+
+
+/* Send request with its data and wait valid response in frame (owned by the caller), timeout of command if timeout_ms is 0 */
+bool CM1106_Protocol::transaction(const CM1106_command &command, const uint8_t data[], uint8_t frame[], uint16_t timeout_ms) {
+    CM1106_Guard guard(lock);
+
+    // Unsupported commands fail without bus traffic
+    if (!(capabilities & (1 << command.id))) {
+        CM1106_LOG("DEBUG: Command 0x%02x not supported!\n", command.cmd);
+        start_receive(frame);
+        return false;
+    }
+
+    // A pending non-blocking request ends first, its result is kept for poll()
+    if (pending_status == CM1106_POLL_PENDING) {
+        update_pending(true);
+        if (pending_status == CM1106_POLL_PENDING) {
+            pending_status = CM1106_POLL_ERROR;
+        }
+    }
+
+    // Explicit timeout (probes): one attempt
+    if (timeout_ms > 0) {
+        return exchange(command, data, frame, timeout_ms) == CM1106_EXCHANGE_OK;
+    }
+
+    bool lost = is_lost();
+    bool waited_full = false;
+    uint16_t backoff = CM1106_BACKOFF;
+    uint8_t attempt = 0;
+
+    while (true) {
+        uint16_t timeout = waited_full ? command.timeout_ms : rto(command);
+        unsigned long start_us = cm1106_micros();
+        uint8_t result = exchange(command, data, frame, timeout);
+
+        if (result == CM1106_EXCHANGE_OK) {
+            // Round trip time of retries is ambiguous, not sampled
+            if (attempt == 0) {
+                update_rtt(command, cm1106_micros() - start_us);
+            }
+            silent = 0;
+            return true;
+        }
+
+        if (result == CM1106_EXCHANGE_NAK) {
+            silent = 0;
+            return false;
+        }
+
+        if (result == CM1106_EXCHANGE_GARBLED) {
+            // Sensor is there but the line is noisy: retry after a growing pause
+            silent = 0;
+            if (attempt >= retries) {
+                return false;
+            }
+            CM1106_LOG("DEBUG: Garbled response, retry in %d ms\n", backoff);
+            cm1106_delay(backoff);
+            backoff *= 2;
+
+        } else {
+            // No response: wait once the full timeout of the command, unless the sensor is lost
+            if (lost || waited_full || timeout >= command.timeout_ms) {
+                if (silent < 255) {
+                    silent++;
+                }
+                return false;
+            }
+            waited_full = true;
+        }
+
+        attempt++;
+    }
+}
+
+
+/* Send request once and wait its response */
+uint8_t CM1106_Protocol::exchange(const CM1106_command &command, const uint8_t data[], uint8_t frame[], uint16_t timeout_ms) {
+
+    uint16_t received = parser.get_received();
+    CM1106_STAT(unsigned long start = cm1106_millis());
+    send_request(command, data);
+
+    // Wait response
+    uint8_t nb = serial_read_bytes(frame, command.resp_len, timeout_ms);
+    CM1106_STAT(stats_response(command, frame, nb, start));
+
+    if (valid_response_len(command.cmd, frame, nb, command.resp_len)) {
+        return CM1106_EXCHANGE_OK;
+    }
+    if (nb > 0 && frame[0] == CM1106_MSG_NAK) {
+        return CM1106_EXCHANGE_NAK;
+    }
+
+    return (nb > 0 || parser.get_received() != received) ? CM1106_EXCHANGE_GARBLED : CM1106_EXCHANGE_SILENT;
+}
+
+
+/* Adaptive timeout (ms) of a command: smoothed round trip time plus 4 deviations */
+uint16_t CM1106_Protocol::rto(const CM1106_command &command) {
+
+    if (!adaptive || rtt_avg[command.id] == 0) {
+        return command.timeout_ms;
+    }
+
+    uint32_t timeout = ((uint32_t)rtt_avg[command.id] + 4 * (uint32_t)rtt_dev[command.id]) * CM1106_RTT_UNIT / 1000 + 1;
+
+    if (timeout < CM1106_RTO_MIN) {
+        return CM1106_RTO_MIN;
+    }
+
+    return timeout < command.timeout_ms ? timeout : command.timeout_ms;
+}
+
+
+/* Add a round trip time sample (gains 1/8 for average and 1/4 for deviation) */
+void CM1106_Protocol::update_rtt(const CM1106_command &command, unsigned long rtt_us) {
+    uint32_t sample = rtt_us / CM1106_RTT_UNIT;
+    uint16_t &avg = rtt_avg[command.id];
+    uint16_t &dev = rtt_dev[command.id];
+
+    if (sample == 0) {
+        sample = 1;
+    } else if (sample > 0xFFFF) {
+        sample = 0xFFFF;
+    }
+
+    if (avg == 0) {
+        avg = sample;
+        dev = sample / 2;
+    } else {
+        int32_t error = (int32_t)sample - avg;
+        avg += error / 8;
+        dev += ((error < 0 ? -error : error) - (int32_t)dev) / 4;
+    }
+}
+
+
+/* Send request with its data */
+void CM1106_Protocol::send_request(const CM1106_command &command, const uint8_t data[]) {
+
+    tx_cmd = command.cmd;
+    discard_stale();
+    parser.expect(command.resp_len);
+
+    if (command.req_len == 4) {
+        // Precomputed frame
+        serial_write_bytes(command.frame, 4);
+
+    } else {
+        // Header and its checksum are precomputed, add data
+        uint8_t frame[CM1106_LEN_BUF_MSG];
+        uint8_t cs = command.frame[3];
+
+        memcpy(frame, command.frame, 3);
+        for (uint8_t i = 0; i < command.req_len - 4; i++) {
+            frame[3 + i] = data[i];
+            cs -= data[i];
+        }
+        frame[command.req_len - 1] = cs;
+
+        serial_write_bytes(frame, command.req_len);
+    }
+}
+
+
 /* Send bytes to sensor */
-void CM1106_UART::serial_write_bytes(uint8_t size) {
+void CM1106_Protocol::serial_write_bytes(const uint8_t *frame, uint8_t size) {
 
 #if (CM1106_LOG_LEVEL > CM1106_LOG_LEVEL_NONE)
     CM1106_LOG("DEBUG: Bytes to send => ");
-    print_buffer(size);
+    print_buffer(frame, size);
 #endif
 
-    mySerial->write(buf_msg, size);
-    mySerial->flush();
+    write_frame(frame, size);
+    CM1106_STAT(stats.bytes_tx += size);
 }
 
 
 /* Read answer of sensor */
-uint8_t CM1106_UART::serial_read_bytes(uint8_t max_bytes, int timeout_seconds) {
-    time_t start_t, end_t;
-    //double diff_t;
-    time(&start_t); end_t = start_t;
-    bool readed = false;
+uint8_t CM1106_Protocol::serial_read_bytes(uint8_t frame[], uint8_t max_bytes, uint16_t timeout_ms) {
 
-    uint8_t nb = 0;
-    if (max_bytes > 0 && timeout_seconds > 0) {
+    start_receive(frame);
+
+    if (max_bytes > 0 && timeout_ms > 0) {
 
         CM1106_LOG("DEBUG: Bytes received => ");
 
-        while ((difftime(end_t, start_t) <= timeout_seconds) && !readed) {
-            if(mySerial->available()) {
-                nb = mySerial->readBytes(buf_msg, max_bytes);
-                readed = true;
-            }
-            time(&end_t);
-        }
+        // Finish as soon as a response to the sent command is received
+        wait_response(timeout_ms);
 
 #if (CM1106_LOG_LEVEL > CM1106_LOG_LEVEL_NONE)
-        print_buffer(nb);
+        print_buffer(frame, rx_nb);
 #endif
 
     } else {
         CM1106_LOG("DEBUG: Invalid parameters!\n");
     }
 
+    return rx_nb;
+}
+
+
+/* Prepare reception of a new response in frame */
+void CM1106_Protocol::start_receive(uint8_t frame[]) {
+    memset(frame, 0, CM1106_LEN_BUF_MSG);
+    rx_buf = frame;
+    rx_nb = 0;
+}
+
+
+/* Discard stale received bytes, counted as received in statistics */
+uint16_t CM1106_Protocol::discard_stale() {
+    uint16_t nb = discard_bytes();
+    CM1106_STAT(stats.bytes_rx += nb);
     return nb;
 }
 
 
+/* Parse stored bytes, true when a response to the sent command (or NAK) is found */
+bool CM1106_Protocol::take_frame() {
+    uint8_t frame_type;
+
+    while ((frame_type = parser.parse()) != CM1106_FRAME_NONE) {
+
+        if (frame_type == CM1106_FRAME_NAK || parser.get_frame()[2] == tx_cmd) {
+            rx_nb = parser.get_frame_len();
+            memcpy(rx_buf, parser.get_frame(), rx_nb);
+            return true;
+        }
+
+        // Late response of a previous command
+        CM1106_LOG("DEBUG: Discarded response of command 0x%02x\n", parser.get_frame()[2]);
+    }
+
+    return false;
+}
+
+
 /* Check valid response and length of received message */
-bool CM1106_UART::valid_response_len(uint8_t cmd, uint8_t nb, uint8_t len) {
+bool CM1106_Protocol::valid_response_len(uint8_t cmd, const uint8_t frame[], uint8_t nb, uint8_t len) {
     bool result = false;
 
     if (nb == len) {
-        result = valid_response(cmd, nb);
+        result = valid_response(cmd, frame, nb);
     } else {
         CM1106_LOG("DEBUG: Unexpected length\n");
     }
@@ -431,18 +1210,18 @@ bool CM1106_UART::valid_response_len(uint8_t cmd, uint8_t nb, uint8_t len) {
 
 
 /* Check if it is a valid message response of the sensor */
-bool CM1106_UART::valid_response(uint8_t cmd, uint8_t nb) {
+bool CM1106_Protocol::valid_response(uint8_t cmd, const uint8_t frame[], uint8_t nb) {
     bool result = false;
 
     if (nb >= 4) {
-        if (buf_msg[nb-1] == calculate_cs(nb) && buf_msg[1] == nb-3) {
+        if (frame[nb-1] == calculate_cs(frame, nb) && frame[1] == nb-3) {
 
-            if (buf_msg[0] == CM1106_MSG_ACK && buf_msg[2] == cmd) {
+            if (frame[0] == CM1106_MSG_ACK && frame[2] == cmd) {
                 CM1106_LOG("DEBUG: Valid response\n");
                 result = true;
 
-            } else if (buf_msg[0] == CM1106_MSG_NAK && nb == 4) {
-                CM1106_LOG("DEBUG: Response with error 0x%02x\n", buf_msg[2]);
+            } else if (frame[0] == CM1106_MSG_NAK && nb == 4) {
+                CM1106_LOG("DEBUG: Response with error 0x%02x\n", frame[2]);
                 // error 0x02 = cmd not recognised, invalid checksum...
                 // If invalid length then no response.
             }
@@ -460,31 +1239,35 @@ bool CM1106_UART::valid_response(uint8_t cmd, uint8_t nb) {
 
 
 /* Send command without addtional data */
-void CM1106_UART::send_cmd(uint8_t cmd) {
-    send_cmd_data(cmd, 4);
+void CM1106_Protocol::send_cmd(uint8_t cmd) {
+    uint8_t frame[4];
+    send_cmd_data(cmd, frame, 4);
 }
 
 
-/* Send command with addtional data */
-void CM1106_UART::send_cmd_data(uint8_t cmd, uint8_t size) {
+/* Send command with addtional data (already in frame) */
+void CM1106_Protocol::send_cmd_data(uint8_t cmd, uint8_t frame[], uint8_t size) {
     if (size >= 4 && size <= CM1106_LEN_BUF_MSG) {
-        buf_msg[0] = CM1106_MSG_IP;   // Packet identifier
-        buf_msg[1] = size-3;            // Length
-        buf_msg[2] = cmd;             // Command to send
-        buf_msg[size-1] = calculate_cs(size);
-        serial_write_bytes(size);
+        frame[0] = CM1106_MSG_IP;   // Packet identifier
+        frame[1] = size-3;            // Length
+        frame[2] = cmd;             // Command to send
+        frame[size-1] = calculate_cs(frame, size);
+        tx_cmd = cmd;
+        discard_stale();
+        parser.expect(0);
+        serial_write_bytes(frame, size);
     }
 }
 
 
 /* Calculate checksum */
-uint8_t CM1106_UART::calculate_cs(uint8_t nb) {
+uint8_t CM1106_Protocol::calculate_cs(const uint8_t frame[], uint8_t nb) {
     uint8_t cs = 0;
 
     if (nb >= 4) {
-        cs = buf_msg[0] + buf_msg[1] + buf_msg[2];
+        cs = frame[0] + frame[1] + frame[2];
         for (int i = 3; i < (nb-1); i++) {
-            cs = cs + buf_msg[i];
+            cs = cs + frame[i];
         }
         cs = 256 - (cs % 256);
         CM1106_LOG("DEBUG: Checksum => 0x%02x\n", cs);
@@ -498,48 +1281,71 @@ uint8_t CM1106_UART::calculate_cs(uint8_t nb) {
 
 
 /* Show buffer in hex bytes */
-void CM1106_UART::print_buffer(uint8_t size) {
+void CM1106_Protocol::print_buffer(const uint8_t *buffer, uint8_t size) {
+    (void)buffer;
 
+#ifdef CM1106_LOG_DEFERRED
+    // One record with the bytes, formatted by the decoder
+    CM1106_LOG("%s(%u bytes)\n", CM1106_LogBuffer(buffer, size), size);
+#else
     for (int i = 0; i < size; i++) {
-        CM1106_LOG("0x%02x ", buf_msg[i]);
+        CM1106_LOG("0x%02x ", buffer[i]);
     }
     CM1106_LOG("(%u bytes)\n", size);
+#endif
 }
 
 
 #ifdef CM1106_ADVANCED_FUNC
 
 /* Detect implemented Cubic UART commands */
-void CM1106_UART::detect_commands() {
+void CM1106_Protocol::detect_commands() {
 
+    CM1106_Guard guard(lock);
+    uint8_t frame[CM1106_LEN_BUF_MSG];
     uint8_t nb = 0;
+    uint32_t latency_us;
+    uint16_t timeout = CM1106_TIMEOUT_MS;
+
+    // Wait each command only as long as the sensor needs to answer
+    if (measure_latency(frame, &latency_us)) {
+        timeout = probe_timeout(latency_us, 4 + CM1106_LEN_BUF_MSG);
+    }
 
     for (uint16_t i = 0x01; i <= 0x5f; i++) {
         send_cmd(i);
-        nb = serial_read_bytes(CM1106_LEN_BUF_MSG, CM1106_TIMEOUT);
-        if (valid_response(i, nb)) {
-            CM1106_LOG("Command 0x%02x implemented\n", buf_msg[2]);
+        nb = serial_read_bytes(frame, CM1106_LEN_BUF_MSG, timeout);
+        if (valid_response(i, frame, nb)) {
+            CM1106_LOG("Command 0x%02x implemented\n", frame[2]);
         } else {
-            CM1106_LOG("Command 0x%02x not available\n", buf_msg[2]);
+            CM1106_LOG("Command 0x%02x not available\n", i);
         }
     }
 }
 
 
 /* Check implemented commands */
-void CM1106_UART::test_implemented() {
+void CM1106_Protocol::test_implemented() {
     char cmds[26] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x0d, 0x0e, 0x0f, 0x10, 0x1e, 0x1f, 0x23, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x4b, 0x4c};
     //char cmds[1] = {0x02};
 
+    CM1106_Guard guard(lock);
+    uint8_t frame[CM1106_LEN_BUF_MSG];
     uint8_t nb = 0;
+    uint32_t latency_us;
+    uint16_t timeout = CM1106_TIMEOUT_MS;
+
+    if (measure_latency(frame, &latency_us)) {
+        timeout = probe_timeout(latency_us, 4 + CM1106_LEN_BUF_MSG);
+    }
 
     for (uint8_t i = 0; i < sizeof(cmds); i++) {
         send_cmd(cmds[i]);
-        nb = serial_read_bytes(CM1106_LEN_BUF_MSG, CM1106_TIMEOUT);
-        if (valid_response(cmds[i], nb)) {
-            CM1106_LOG("Command 0x%02x implemented\n", buf_msg[2]);
+        nb = serial_read_bytes(frame, CM1106_LEN_BUF_MSG, timeout);
+        if (valid_response(cmds[i], frame, nb)) {
+            CM1106_LOG("Command 0x%02x implemented\n", frame[2]);
         } else {
-            CM1106_LOG("Command 0x%02x not available\n", buf_msg[2]);
+            CM1106_LOG("Command 0x%02x not available\n", cmds[i]);
         }
     }
 }
@@ -549,16 +1355,17 @@ void CM1106_UART::test_implemented() {
 
 /*
 // test cmd
-void CM1106_UART::test_cmd() {
+void CM1106_Protocol::test_cmd() {
+
+    uint8_t frame[CM1106_LEN_BUF_MSG];
 
     // Put data in buffer
-    buf_msg[3] = 0x00;
+    frame[3] = 0x00;
 
     // Ask
-    send_cmd_data(0x02, 5);
+    send_cmd_data(0x02, frame, 5);
 
     // Wait response
-    memset(buf_msg, 0, CM1106_LEN_BUF_MSG);
-    serial_read_bytes(20, CM1106_TIMEOUT);
+    serial_read_bytes(frame, 20, CM1106_TIMEOUT_MS);
 }
 */
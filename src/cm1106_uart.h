@@ -27,13 +27,15 @@ SOFTWARE.
 #ifndef _CM1106_UART
     #define _CM1106_UART
 
-    #if defined ARDUINO_ARCH_SAMD || defined ARDUINO_ARCH_SAM21D || defined ARDUINO_ARCH_ESP32 || defined ARDUINO_SAM_DUE || ARDUINO_ARCH_APOLLO3
+    #if defined ARDUINO_ARCH_SAMD || defined ARDUINO_ARCH_SAM21D || defined ARDUINO_ARCH_ESP32 || defined ARDUINO_SAM_DUE || ARDUINO_ARCH_APOLLO3 || defined CM1106_NATIVE
         #undef USE_SOFTWARE_SERIAL
     #else
         #define USE_SOFTWARE_SERIAL
     #endif
 
     #include "Arduino.h"
+    #include "cm1106_lock.h"
+    #include "cm1106_clock.h"
 
     #ifdef USE_SOFTWARE_SERIAL       
         #include <SoftwareSerial.h>
@@ -69,8 +71,17 @@ SOFTWARE.
             #define CM1106_DEBUG_SERIAL Serial
         #endif
 
-        /* Debug format */
-        #define CM1106_LOG(format, ...) CM1106_DEBUG_SERIAL.printf(format, ##__VA_ARGS__)
+        // Uncomment to store binary records in RAM instead of printing (see cm1106_log_dump())
+        //#define CM1106_LOG_DEFERRED
+
+        #ifdef CM1106_LOG_DEFERRED
+            /* Deferred: record format identifier and arguments, decoded on host by extras/tools/cm1106_log_decode.py */
+            #include "cm1106_log.h"
+            #define CM1106_LOG(format, ...) cm1106_log<cm1106_log_hash(format)>(__VA_ARGS__)
+        #else
+            /* Debug format */
+            #define CM1106_LOG(format, ...) CM1106_DEBUG_SERIAL.printf(format, ##__VA_ARGS__)
+        #endif
     #else
         #define CM1106_LOG(format, ...)
     #endif
@@ -78,9 +89,32 @@ SOFTWARE.
     #define CM1106_BAUDRATE 9600         // Device to CM1106 Serial baudrate (should not be changed)
 
     //#define CM1106_ADVANCED_FUNC  1      // Don't uncomment, can be dangerous, internal use functions
+    //#define CM1106_STATS  1              // Uncomment to count transactions, errors and latencies (see get_stats())
+
+    #ifdef CM1106_STATS
+        #define CM1106_STAT(code) code
+    #else
+        #define CM1106_STAT(code)
+    #endif
+
+    #include "cm1106_parser.h"          // After CM1106_STATS, which selects the counters of the parser
+
 
+    #define CM1106_TIMEOUT_MS     100   // Timeout for communication (ms)
+    #define CM1106_TIMEOUT_WRITE  500   // Timeout for commands which store settings in the sensor (ms)
+    #define CM1106_NUM_COMMANDS    11   // Number of command descriptors (see cm1106_commands.h)
+    #define CM1106_BYTE_TIME     1042   // Transfer time of one byte at 9600 8N1 (us)
+    #define CM1106_PROBE_MARGIN     5   // Margin added to expected response time when probing capabilities (ms)
+    #define CM1106_PROBE_SILENCES   2   // Probes without response to consider a command unsupported
+    #define CM1106_PROBE_TIMEOUT   40   // Deadline of each presence request of probe() (ms)
+    #define CM1106_PROBE_ATTEMPTS   2   // Presence requests of probe() before the sensor is considered absent
 
-    #define CM1106_TIMEOUT  5     // Timeout for communication
+    #define CM1106_RTO_MIN         10   // Min adaptive timeout (ms)
+    #define CM1106_RTT_UNIT       125   // Unit of smoothed round trip time (us)
+    #define CM1106_RETRIES          2   // Default retries of garbled responses (checksum or length errors)
+    #define CM1106_BACKOFF          5   // Delay before first retry, doubled on each retry (ms)
+    #define CM1106_LOST_TIMEOUTS    3   // Consecutive requests without response to consider the sensor lost
+    #define CM1106_FLUSH_QUIET      5   // Silence of the line (ms) ending flush() of stale received bytes
 
     #define CM1106_ABC_OPEN   0   // Open ABC (enable auto calibration)
     #define CM1106_ABC_CLOSE  2   // Close ABC (disable auto calibration)
@@ -89,6 +123,7 @@ SOFTWARE.
     #define CM1106_LEN_SOFTVER  10   // Length of software version
 
     #define CM1106_LEN_BUF_MSG  20   // Max length of buffer for communication with the sensor
+    #define CM1106_POS_DATA      3   // Position of first data byte in messages
     #define CM1106_MSG_IP     0x11   // Packet identifier byte of sensor communication response 
     #define CM1106_MSG_ACK    0x16   // ACK byte of sensor communication response 
     #define CM1106_MSG_NAK    0x06   // NAK byte of sensor communication response 
@@ -109,6 +144,42 @@ SOFTWARE.
     #define CM1106_SINGLE_MEASUREMENT            0   // Single measurement mode (command A)
     #define CM1106_CONTINUOUS_MEASUREMENT        1   // Continuous measurment mode (command B)
 
+    /* Cached device metadata (see enable_cache) */
+    #define CM1106_CACHE_SN                   0x01   // Serial number
+    #define CM1106_CACHE_SOFTVER              0x02   // Software version
+    #define CM1106_CACHE_ABC                  0x04   // ABC parameters
+    #define CM1106_CACHE_PERIOD               0x08   // Measurement period and number of smoothed data
+    #define CM1106_CACHE_STATUS               0x10   // Working status
+    #define CM1106_CACHE_ALL                  0x1F
+
+    /* Status of non-blocking requests returned by poll() */
+    #define CM1106_POLL_IDLE                     0   // No request in progress
+    #define CM1106_POLL_PENDING                  1   // Waiting response of the sensor
+    #define CM1106_POLL_READY                    2   // Valid response received
+    #define CM1106_POLL_ERROR                    3   // Invalid response or timeout
+
+
+    /* Checksum of a frame from the sum of its bytes (without checksum) */
+    constexpr uint8_t cm1106_checksum(unsigned int sum) {
+        return (uint8_t)(256 - (sum % 256));
+    }
+
+    /* Descriptor of a command (see cm1106_commands.h) */
+    struct CM1106_command {
+        uint8_t id;              // Index of descriptor
+        uint8_t cmd;             // Command byte
+        uint8_t req_len;         // Total length of request
+        uint8_t resp_len;        // Total length of valid response
+        uint16_t timeout_ms;     // Timeout of response (ms)
+        uint8_t frame[4];        // Header of request and its checksum (whole request if it has no data)
+    };
+
+    /* Define a command descriptor: frame lengths and checksum of header are computed at compile time */
+    #define CM1106_COMMAND(name, id, cmd, req_data, resp_data, timeout)                                      \
+        static constexpr CM1106_command name = {(id), (cmd), (req_data) + 4, (resp_data) + 4, (timeout),      \
+            {CM1106_MSG_IP, (req_data) + 1, (cmd), cm1106_checksum(CM1106_MSG_IP + (req_data) + 1 + (cmd))}}; \
+        static_assert((req_data) + 4 <= CM1106_LEN_BUF_MSG && (resp_data) + 4 <= CM1106_LEN_BUF_MSG, "Invalid length of " #name)
+
 
     struct CM1106_ABC {
         uint8_t open_close;
@@ -122,14 +193,57 @@ SOFTWARE.
         int16_t co2;
     };
 
+    #define CM1106_CAPS_ALL       0x07FF   // Capabilities with all commands supported (one bit per command descriptor)
+    #define CM1106_CAPS_CM1106    0x003F   // Commands of CM1106 (without commands of low power version)
+    #define CM1106_CAPS_MANDATORY 0x0011   // Commands never disabled: CO2 and software version
+
+    /* Models detected by probe() */
+    #define CM1106_MODEL_NONE          0   // No sensor answering
+    #define CM1106_MODEL_UNKNOWN       1   // Unknown software version, all commands allowed
+    #define CM1106_MODEL_CM1106        2   // CM1106
+    #define CM1106_MODEL_SL_N          3   // Low power version CM1106SL-N(S)
+
+    struct CM1106_capabilities {
+        char softver[CM1106_LEN_SOFTVER + 1];  // Software version of probed sensor
+        uint16_t commands;                     // Supported commands (bit per command descriptor)
+    };
+
+    #define CM1106_STATS_BUCKETS       8   // Buckets of latency histogram: <10, <15, <20, <30, <50, <100, <200, >=200 ms
+    #define CM1106_STATS_NAK_CODES     8   // NAK error codes counted (last one also counts greater codes)
+
+    struct CM1106_stats {
+        uint32_t transactions[CM1106_NUM_COMMANDS];    // Requests sent per command (index CM1106_ID_xxx)
+        uint32_t timeouts;                             // Requests without any response
+        uint32_t short_frames;                         // Responses incomplete or with unexpected length
+        uint32_t checksum_errors;                      // Candidate frames with wrong checksum
+        uint32_t naks;                                 // NAK responses
+        uint32_t nak_codes[CM1106_STATS_NAK_CODES];    // NAK responses per error code
+        uint32_t resyncs;                              // Candidate frames rejected by the parser
+        uint32_t latency[CM1106_STATS_BUCKETS];        // Round trip time of answered requests
+        uint32_t bytes_tx;                             // Bytes sent
+        uint32_t bytes_rx;                             // Bytes received
+    };
+
+    #define CM1106_READING_OK          0   // Valid reading
+    #define CM1106_READING_ERROR       1   // Sensor did not answer a valid value
+    #define CM1106_READING_REJECTED    2   // Value rejected by a filter (see cm1106_filter.h)
+
+    struct CM1106_reading {
+        uint32_t timestamp;                // Time of reading (ms)
+        int16_t co2;                       // CO2 value in ppm (0 if error)
+        uint8_t status;                    // CM1106_READING_xxx
+    };
+
 
-    class CM1106_UART
+    /* Protocol of the sensor, independent of the type of serial port (see CM1106_UART_T) */
+    class CM1106_Protocol
     {
         public:
-            CM1106_UART(Stream &serial);                                        // Initialize
+            virtual ~CM1106_Protocol() {}
             void get_serial_number(char sn[]);                                  // Get serial number
             void get_software_version(char softver[]);                          // Get software version
             int16_t get_co2();                                                  // Get CO2 value in ppm
+            bool get_co2(int16_t *co2);                                         // Get CO2 value in ppm, false on error
             bool start_calibration(int16_t concentration);                      // Start single point calibration
                                                                                    // Before calibration, please make sure CO2 concentration in current ambient 
                                                                                    // is calibration target value. Keeping this CO2 concentration for two 2 minutes,
@@ -145,24 +259,210 @@ SOFTWARE.
             bool store_ABC_data();                                              // Store ABC data
 //            void test_cmd();  
 
+            /* Cache of device metadata (serial number, software version, ABC, measurement period and working status) */
+            void enable_cache(bool enable);                                     // Enable/disable cache (disabled by default)
+            uint8_t refresh();                                                  // Invalidate cache and read all metadata again, return CM1106_CACHE_xxx read
+            void invalidate_cache(uint8_t items = CM1106_CACHE_ALL);           // Invalidate cached items (CM1106_CACHE_xxx)
+
+            /* Detection: presence with a short deadline, then model from software version */
+            uint8_t probe(CM1106_sensor *sensor = NULL);                        // Detect sensor, read version and serial number, return CM1106_MODEL_xxx
+            uint8_t get_model();                                                // Get model detected by last probe (CM1106_MODEL_xxx)
+
+            /* Capabilities: unsupported commands fail at once without sending them */
+            bool probe_capabilities(CM1106_capabilities *caps);                 // Detect supported commands with short timeouts
+            bool set_capabilities(const CM1106_capabilities *caps);             // Apply capabilities saved by the caller, if software version matches
+            bool is_supported(uint8_t cmd);                                     // Check if a command (CM1106_CMD_xxx) is supported
+
+            /* Timeout and retry policy: timeouts follow the measured round trip time of each command */
+            void set_adaptive_timeout(bool enable);                             // Enable/disable adaptive timeouts (enabled by default)
+            void set_retries(uint8_t retries);                                  // Set retries of garbled responses (CM1106_RETRIES by default)
+            uint16_t get_timeout(uint8_t id);                                   // Get current timeout (ms) of a command (CM1106_ID_xxx)
+            bool is_lost();                                                     // Check if the sensor stopped answering
+            void flush();                                                       // Drop pending request and received bytes until the line is quiet
+
+#ifdef CM1106_STATS
+            /* Statistics: word counters written by the request in progress, read without lock */
+            void get_stats(CM1106_stats *stats);                                // Copy statistics
+            void reset_stats();                                                 // Clear statistics
+#endif
+
+            /* Non-blocking requests */
+            bool begin_get_co2();                                               // Send CO2 request without waiting response
+            uint8_t poll();                                                     // Process received bytes of pending request (CM1106_POLL_xxx)
+            int16_t get_last_co2();                                             // Get CO2 value in ppm of last completed non-blocking request
+            bool begin_get_ABC();                                               // Send ABC request without waiting response
+            bool get_last_ABC(CM1106_ABC *abc);                                 // Get ABC parameters of last completed non-blocking request
+
 #ifdef CM1106_ADVANCED_FUNC
             void detect_commands();                                             // Detect implemented commands
             void test_implemented();                                            // Check implemented commands
 #endif
 
+        protected:
+            CM1106_Protocol();                                                  // Initialize
+
+            /* Serial I/O implemented by CM1106_UART_T */
+            virtual void write_frame(const uint8_t *frame, uint8_t size) = 0;   // Write bytes to serial port
+            virtual bool receive_bytes() = 0;                                   // Take available bytes, true when response is complete
+            virtual bool wait_response(uint16_t timeout_ms) = 0;                // Take bytes until response is complete or timeout
+            virtual uint16_t discard_bytes() = 0;                               // Discard stale received bytes, return number of bytes discarded
+
+            CM1106_Parser parser;                                               // Parser of received bytes
+            uint16_t discard_stale();                                           // Discard stale received bytes, counted as received in statistics
+            bool take_frame();                                                  // Parse stored bytes, true when response to sent command (or NAK) is found
+
         private:
-            Stream* mySerial;                                                   // Communication serial with the sensor
-            uint8_t buf_msg[CM1106_LEN_BUF_MSG];                                // Buffer for communication messages with the sensor
+            CM1106_Lock lock;                                                   // Serialize transactions of several tasks
+
+            uint8_t pending_status;                                             // Status of non-blocking request (CM1106_POLL_xxx)
+            const CM1106_command *pending_cmd;                                  // Command of pending request
+            unsigned long pending_start;                                        // Time (ms) when pending request was sent
+            uint16_t pending_timeout;                                           // Timeout (ms) of pending request
+            uint8_t pending_frame[CM1106_LEN_BUF_MSG];                          // Response of pending request
+            uint8_t tx_cmd;                                                     // Last command sent to the sensor
+            uint8_t *rx_buf;                                                    // Buffer of current response (owned by the request)
+            uint8_t rx_nb;                                                      // Bytes received of current response
+            int16_t last_co2;                                                   // CO2 value of last completed non-blocking request
+            CM1106_ABC last_abc;                                                // ABC parameters of last completed non-blocking request
+
+            bool cache_enabled;                                                 // Cache of metadata enabled
+            uint8_t cache_valid;                                                // Valid cached items (CM1106_CACHE_xxx)
+            char cache_sn[CM1106_LEN_SN + 1];                                   // Cached serial number
+            char cache_softver[CM1106_LEN_SOFTVER + 1];                         // Cached software version
+            CM1106_ABC cache_abc;                                               // Cached ABC parameters
+            int16_t cache_period;                                               // Cached measurement period
+            uint8_t cache_smoothed;                                             // Cached number of smoothed data
+            uint8_t cache_status;                                               // Cached working status
+
+            uint16_t capabilities;                                              // Supported commands (bit per command descriptor)
+            uint8_t model;                                                      // Model detected by probe (CM1106_MODEL_xxx)
+
+            bool adaptive;                                                      // Adaptive timeouts enabled
+            uint8_t retries;                                                    // Retries of garbled responses
+            uint8_t silent;                                                     // Consecutive requests without response
+            uint16_t rtt_avg[CM1106_NUM_COMMANDS];                              // Smoothed round trip time per command (CM1106_RTT_UNIT)
+            uint16_t rtt_dev[CM1106_NUM_COMMANDS];                              // Smoothed deviation of round trip time per command (CM1106_RTT_UNIT)
+            unsigned long pending_start_us;                                     // Time (us) when pending request was sent
+
+#ifdef CM1106_STATS
+            CM1106_stats stats;                                                 // Statistics
+            uint16_t stats_resyncs;                                             // Parser counters already added to statistics
+            uint16_t stats_checksum_errors;
+            uint16_t stats_received;
+
+            void stats_response(const CM1106_command &command, const uint8_t frame[], uint8_t nb, unsigned long start);  // Count result of a request
+#endif
 
-            void serial_write_bytes(uint8_t size);                              // Send bytes to sensor
-            uint8_t serial_read_bytes(uint8_t max_bytes, int timeout_seconds);  // Read received bytes from sensor
-            bool valid_response(uint8_t cmd, uint8_t nb);                       // Check if response is valid according to sent command
-            bool valid_response_len(uint8_t cmd, uint8_t nb, uint8_t len);      // Check if response is valid according to sent command and checking expected total length
+            bool cached(uint8_t item);                                          // Check if item is cached
+            void format_serial_number(const uint8_t *data, char sn[]);          // Format serial number without printf
+
+            bool transaction(const CM1106_command &command, const uint8_t data[], uint8_t frame[], uint16_t timeout_ms = 0);  // Send request with its data and wait valid response in frame
+            uint8_t exchange(const CM1106_command &command, const uint8_t data[], uint8_t frame[], uint16_t timeout_ms);  // Send request once and wait its response, return CM1106_EXCHANGE_xxx
+            uint16_t rto(const CM1106_command &command);                        // Adaptive timeout (ms) of a command
+            void update_rtt(const CM1106_command &command, unsigned long rtt_us);  // Add a round trip time sample
+            bool measure_latency(uint8_t frame[], uint32_t *latency_us);        // Get software version in frame and measure response latency of the sensor
+            uint16_t probe_timeout(uint32_t latency_us, uint8_t nb_bytes);      // Timeout (ms) of a probe transferring nb_bytes
+            void send_request(const CM1106_command &command, const uint8_t data[]);  // Send request with its data
+            bool begin_request(const CM1106_command &command);                  // Send request without data and without waiting response
+            void update_pending(bool wait);                                     // Check response of pending non-blocking request
+            void decode_ABC(const uint8_t *data, CM1106_ABC *abc);              // Decode ABC parameters of response
+            void serial_write_bytes(const uint8_t *frame, uint8_t size);        // Send bytes to sensor
+            uint8_t serial_read_bytes(uint8_t frame[], uint8_t max_bytes, uint16_t timeout_ms);  // Read received bytes from sensor
+            void start_receive(uint8_t frame[]);                                // Prepare reception of a new response in frame
+            bool valid_response(uint8_t cmd, const uint8_t frame[], uint8_t nb);  // Check if response is valid according to sent command
+            bool valid_response_len(uint8_t cmd, const uint8_t frame[], uint8_t nb, uint8_t len);  // Check if response is valid according to sent command and checking expected total length
             void send_cmd(uint8_t cmd);                                         // Send command without additional data
-            void send_cmd_data(uint8_t cmd, uint8_t size);                      // Send command with additional data
-            uint8_t calculate_cs(uint8_t nb);                                   // Calculate checksum of packet
-            void print_buffer(uint8_t size);                                    // Show buffer in hex bytes
+            void send_cmd_data(uint8_t cmd, uint8_t frame[], uint8_t size);     // Send command with additional data
+            uint8_t calculate_cs(const uint8_t frame[], uint8_t nb);            // Calculate checksum of packet
+            void print_buffer(const uint8_t *buffer, uint8_t size);             // Show buffer in hex bytes
+
+    };
+
 
+    /* Access to serial port of CM1106_UART_T. Calls are qualified with the serial type, so they
+       are resolved at compile time and can be inlined (SerialT must be the real type of the port) */
+    template <class SerialT>
+    struct CM1106_serial_io {
+        static int available(SerialT *serial) { return serial->SerialT::available(); }
+        static int read(SerialT *serial) { return serial->SerialT::read(); }
+        static void write(SerialT *serial, const uint8_t *frame, uint8_t size) { serial->SerialT::write(frame, size); serial->SerialT::flush(); }
     };
 
+    /* Generic Stream, calls through virtual functions */
+    template <>
+    struct CM1106_serial_io<Stream> {
+        static int available(Stream *serial) { return serial->available(); }
+        static int read(Stream *serial) { return serial->read(); }
+        static void write(Stream *serial, const uint8_t *frame, uint8_t size) { serial->write(frame, size); serial->flush(); }
+    };
+
+
+    /* Driver of the sensor for a serial port of type SerialT (HardwareSerial, SoftwareSerial...) */
+    template <class SerialT>
+    class CM1106_UART_T : public CM1106_Protocol
+    {
+        public:
+            CM1106_UART_T(SerialT &serial) : mySerial(&serial) {}               // Initialize
+
+        protected:
+            typedef CM1106_serial_io<SerialT> io;
+
+            /* Write bytes to serial port */
+            void write_frame(const uint8_t *frame, uint8_t size) override {
+                io::write(mySerial, frame, size);
+            }
+
+            /* Take available bytes, true when a response to the sent command (or NAK) is received */
+            bool receive_bytes() override {
+                while (true) {
+
+                    // Move received bytes to ring buffer of parser
+                    while (parser.get_free() > 0 && io::available(mySerial) > 0) {
+                        int c = io::read(mySerial);
+                        if (c < 0) {
+                            break;
+                        }
+                        parser.push((uint8_t)c);
+                    }
+
+                    if (take_frame()) {
+                        return true;
+                    }
+                    if (io::available(mySerial) <= 0) {
+                        return false;
+                    }
+                }
+            }
+
+            /* Take bytes until response is complete or timeout */
+            bool wait_response(uint16_t timeout_ms) override {
+                unsigned long start_ms = cm1106_millis();
+                while (cm1106_millis() - start_ms < timeout_ms) {
+                    if (receive_bytes()) {
+                        return true;
+                    }
+                    // Let other tasks run (and the watchdog be fed) while waiting
+                    cm1106_yield();
+                }
+                return false;
+            }
+
+            /* Discard stale received bytes */
+            uint16_t discard_bytes() override {
+                uint16_t nb = 0;
+                while (io::available(mySerial) > 0) {
+                    io::read(mySerial);
+                    nb++;
+                }
+                parser.reset();
+                return nb;
+            }
+
+        private:
+            SerialT* mySerial;                                                  // Communication serial with the sensor
+    };
+
+    /* Driver of the sensor for any Stream */
+    typedef CM1106_UART_T<Stream> CM1106_UART;
+
 #endif